@@ -0,0 +1,802 @@
+/**
+ * \file
+ *
+ * \brief Benchmarks the secure service transport and offloaded sockets
+ *
+ *  Every result is printed as a single line starting with 'BENCHMARK ' and
+ *  followed by a JSON object, so results can be collected from the console
+ *  and compared across SDK releases and stack firmware ABI versions. The
+ *  first result describes the build, and the last is {"test":"done"}.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <net/socket.h>
+#include <sys/atomic.h>
+#include <sys/byteorder.h>
+#include <zephyr.h>
+
+#include "nimbelink/sdk/secure_services/at.h"
+#include "nimbelink/sdk/secure_services/call.h"
+#include "nimbelink/sdk/secure_services/kernel.h"
+#include "nimbelink/sdk/secure_services/net.h"
+
+#if CONFIG_SECURE_SERVICES_EMULATOR
+#include "nimbelink/sdk/secure_services/emulator.h"
+#endif
+
+#ifdef CONFIG_STACK_ABI_VERSION
+#define BENCHMARK_ABI_VERSION       CONFIG_STACK_ABI_VERSION
+#else
+#define BENCHMARK_ABI_VERSION       "emulated"
+#endif
+
+// The most concurrent callers to measure, one for each channel
+#define BENCHMARK_MAX_CALLERS       SECURE_SERVICE_CHANNEL_COUNT
+
+#define BENCHMARK_CALLER_STACK_SIZE 1024
+
+// Callers run below the wake-up probe, so the probe measures how long they
+// keep it from running
+#define BENCHMARK_CALLER_PRIORITY   K_PRIO_PREEMPT(8)
+#define BENCHMARK_PROBE_PRIORITY    K_PRIO_PREEMPT(1)
+
+// How often the wake-up probe's timer fires, in milliseconds
+#define BENCHMARK_PROBE_PERIOD      1
+
+/**
+ * \brief A set of timing samples
+ */
+struct Measurement
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+};
+
+/**
+ * \brief An operation to measure the latency of
+ */
+struct LatencyBenchmark
+{
+    // The service and API names to report
+    const char *service;
+    const char *api;
+
+    // Runs the operation once
+    int32_t (*run)(void);
+};
+
+// A datagram socket for the networking measurements
+static int32_t benchmarkSocket = -1;
+
+static struct k_thread callers[BENCHMARK_MAX_CALLERS];
+
+static K_THREAD_STACK_ARRAY_DEFINE(callerStacks, BENCHMARK_MAX_CALLERS, BENCHMARK_CALLER_STACK_SIZE);
+
+// Whether or not the callers and probe should keep running
+static atomic_t running = ATOMIC_INIT(0);
+
+// The number of calls the callers made
+static atomic_t calls = ATOMIC_INIT(0);
+
+// The wake-up probe's state
+static struct k_timer probeTimer;
+static K_SEM_DEFINE(probeSemaphore, 0, 1);
+static volatile uint32_t probeExpired;
+static struct Measurement probeLatency;
+
+// A socket payload buffer
+static uint8_t buffer[CONFIG_BENCHMARK_SOCKET_BUFFER_SIZE];
+
+#if CONFIG_SECURE_SERVICES_EMULATOR
+// URC delivery state
+static K_SEM_DEFINE(urcSemaphore, 0, 1);
+static volatile uint32_t urcReceived;
+
+// The loopback server's state
+static struct k_thread serverThread;
+static K_THREAD_STACK_DEFINE(serverStack, 2048);
+static K_SEM_DEFINE(serverReady, 0, 1);
+static uint8_t serverBuffer[1024];
+#endif
+
+/**
+ * \brief Resets a measurement
+ *
+ * \param *measurement
+ *      The measurement to reset
+ *
+ * \return none
+ */
+static void ResetMeasurement(struct Measurement *measurement)
+{
+    measurement->count = 0;
+    measurement->min = UINT32_MAX;
+    measurement->max = 0;
+    measurement->total = 0;
+}
+
+/**
+ * \brief Adds a sample to a measurement
+ *
+ * \param *measurement
+ *      The measurement to add to
+ * \param cycles
+ *      The sample, in cycles
+ *
+ * \return none
+ */
+static void AddSample(struct Measurement *measurement, uint32_t cycles)
+{
+    measurement->count++;
+    measurement->total += cycles;
+
+    if (cycles < measurement->min)
+    {
+        measurement->min = cycles;
+    }
+
+    if (cycles > measurement->max)
+    {
+        measurement->max = cycles;
+    }
+}
+
+/**
+ * \brief Prints a measurement's statistics as JSON members
+ *
+ * \param *measurement
+ *      The measurement to print
+ *
+ * \return none
+ */
+static void PrintMeasurement(const struct Measurement *measurement)
+{
+    if (measurement->count == 0)
+    {
+        printk("\"count\":0");
+        return;
+    }
+
+    uint32_t average = (uint32_t)(measurement->total / measurement->count);
+
+    printk(
+        "\"count\":%u,\"min_us\":%u,\"avg_us\":%u,\"max_us\":%u",
+        measurement->count,
+        k_cyc_to_us_floor32(measurement->min),
+        k_cyc_to_us_floor32(average),
+        k_cyc_to_us_floor32(measurement->max)
+    );
+}
+
+/**
+ * \brief Gets whether or not the scheduler is locked around Secure calls
+ *
+ * \param none
+ *
+ * \return const char *
+ *      The JSON boolean
+ */
+static inline const char *GetSchedLock(void)
+{
+    return IS_ENABLED(CONFIG_SECURE_SERVICES_SCHED_LOCK) ? "true" : "false";
+}
+
+static int32_t RunKernelErrno(void)
+{
+    return Kernel_Errno();
+}
+
+static int32_t RunAtCommand(void)
+{
+    enum At_Result result;
+    union At_Error error;
+    char response[32];
+
+    return At_RunCommand(&result, &error, "AT", 2, response, sizeof(response), NULL);
+}
+
+static int32_t RunNetPoll(void)
+{
+    struct pollfd fd = {
+        .fd = benchmarkSocket,
+        .events = POLLIN
+    };
+
+    return Net_Poll(&fd, 1, 0);
+}
+
+static int32_t RunNetFcntl(void)
+{
+    return Net_Fcntl(benchmarkSocket, F_GETFL, 0);
+}
+
+static int32_t RunNetSocket(void)
+{
+    int32_t fd = Net_Socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+    {
+        return fd;
+    }
+
+    return Net_Close(fd);
+}
+
+static const struct LatencyBenchmark latencyBenchmarks[] = {
+    { "Kernel", "Errno",        RunKernelErrno },
+    { "At",     "RunCommand",   RunAtCommand },
+    { "Net",    "Poll",         RunNetPoll },
+    { "Net",    "Fcntl",        RunNetFcntl },
+    { "Net",    "SocketClose",  RunNetSocket },
+};
+
+/**
+ * \brief Measures the round-trip latency of individual secure service APIs
+ *
+ * \param none
+ *
+ * \return none
+ */
+static void MeasureLatency(void)
+{
+    for (size_t i = 0; i < ARRAY_SIZE(latencyBenchmarks); i++)
+    {
+        const struct LatencyBenchmark *benchmark = &(latencyBenchmarks[i]);
+
+        struct Measurement measurement;
+        uint32_t errors = 0;
+
+        ResetMeasurement(&measurement);
+
+        for (uint32_t j = 0; j < CONFIG_BENCHMARK_ITERATIONS; j++)
+        {
+            uint32_t start = k_cycle_get_32();
+
+            int32_t result = benchmark->run();
+
+            AddSample(&measurement, k_cycle_get_32() - start);
+
+            if (result < 0)
+            {
+                errors++;
+            }
+        }
+
+        printk("BENCHMARK {\"test\":\"latency\",\"service\":\"%s\",\"api\":\"%s\",\"errors\":%u,", benchmark->service, benchmark->api, errors);
+        PrintMeasurement(&measurement);
+        printk("}\n");
+    }
+}
+
+/**
+ * \brief Makes secure service calls until told to stop
+ *
+ * \param *p1
+ *      Unused
+ * \param *p2
+ *      Unused
+ * \param *p3
+ *      Unused
+ *
+ * \return none
+ */
+static void RunCaller(void *p1, void *p2, void *p3)
+{
+    (void)p1;
+    (void)p2;
+    (void)p3;
+
+    while (atomic_get(&running))
+    {
+        Kernel_Errno();
+
+        atomic_inc(&calls);
+    }
+}
+
+/**
+ * \brief Notes when the wake-up probe's timer fired
+ *
+ * \param *timer
+ *      Unused
+ *
+ * \return none
+ */
+static void ProbeExpired(struct k_timer *timer)
+{
+    (void)timer;
+
+    probeExpired = k_cycle_get_32();
+
+    k_sem_give(&probeSemaphore);
+}
+
+/**
+ * \brief Measures how long it takes a high-priority thread to wake up
+ *
+ * \param *p1
+ *      Unused
+ * \param *p2
+ *      Unused
+ * \param *p3
+ *      Unused
+ *
+ * \return none
+ */
+static void RunProbe(void *p1, void *p2, void *p3)
+{
+    (void)p1;
+    (void)p2;
+    (void)p3;
+
+    while (atomic_get(&running))
+    {
+        if (k_sem_take(&probeSemaphore, K_MSEC(10 * BENCHMARK_PROBE_PERIOD)) == 0)
+        {
+            AddSample(&probeLatency, k_cycle_get_32() - probeExpired);
+        }
+    }
+}
+
+/**
+ * \brief Measures call throughput with concurrent callers
+ *
+ *  While the callers run, a high-priority thread measures how long it takes to
+ *  wake up, which shows the scheduling latency added by the callers --
+ *  including any time the scheduler is locked around Secure calls.
+ *
+ * \param none
+ *
+ * \return none
+ */
+static void MeasureThroughput(void)
+{
+    static struct k_thread probe;
+    static K_THREAD_STACK_DEFINE(probeStack, BENCHMARK_CALLER_STACK_SIZE);
+
+    k_timer_init(&probeTimer, ProbeExpired, NULL);
+
+    for (size_t count = 1; count <= BENCHMARK_MAX_CALLERS; count++)
+    {
+        atomic_set(&running, 1);
+        atomic_set(&calls, 0);
+
+        ResetMeasurement(&probeLatency);
+
+        k_sem_reset(&probeSemaphore);
+
+        k_thread_create(&probe, probeStack, K_THREAD_STACK_SIZEOF(probeStack), RunProbe, NULL, NULL, NULL, BENCHMARK_PROBE_PRIORITY, 0, K_NO_WAIT);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            k_thread_create(
+                &(callers[i]),
+                callerStacks[i],
+                K_THREAD_STACK_SIZEOF(callerStacks[i]),
+                RunCaller,
+                NULL,
+                NULL,
+                NULL,
+                BENCHMARK_CALLER_PRIORITY,
+                0,
+                K_NO_WAIT
+            );
+        }
+
+        k_timer_start(&probeTimer, K_MSEC(BENCHMARK_PROBE_PERIOD), K_MSEC(BENCHMARK_PROBE_PERIOD));
+
+        int64_t start = k_uptime_get();
+
+        k_msleep(CONFIG_BENCHMARK_DURATION_MS);
+
+        atomic_set(&running, 0);
+
+        int64_t duration = k_uptime_get() - start;
+
+        k_timer_stop(&probeTimer);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            k_thread_join(&(callers[i]), K_FOREVER);
+        }
+
+        k_thread_join(&probe, K_FOREVER);
+
+        uint32_t total = (uint32_t)atomic_get(&calls);
+
+        printk(
+            "BENCHMARK {\"test\":\"throughput\",\"callers\":%u,\"sched_lock\":%s,\"calls\":%u,\"duration_ms\":%u,\"calls_per_second\":%u}\n",
+            (uint32_t)count,
+            GetSchedLock(),
+            total,
+            (uint32_t)duration,
+            (duration > 0) ? (uint32_t)(((uint64_t)total * MSEC_PER_SEC) / duration) : 0
+        );
+
+        printk("BENCHMARK {\"test\":\"wake_latency\",\"callers\":%u,\"sched_lock\":%s,", (uint32_t)count, GetSchedLock());
+        PrintMeasurement(&probeLatency);
+        printk("}\n");
+    }
+}
+
+#if CONFIG_SECURE_SERVICES_EMULATOR
+/**
+ * \brief Notes when a URC arrived
+ *
+ * \param *urc
+ *      Unused
+ *
+ * \return none
+ */
+static void UrcReceived(const char *urc)
+{
+    (void)urc;
+
+    urcReceived = k_cycle_get_32();
+
+    k_sem_give(&urcSemaphore);
+}
+#endif
+
+/**
+ * \brief Measures how long URCs take to be delivered over the async channel
+ *
+ *  This needs URCs on demand, so it can only be done with the emulator.
+ *
+ * \param none
+ *
+ * \return none
+ */
+static void MeasureUrcLatency(void)
+{
+#if CONFIG_SECURE_SERVICES_EMULATOR
+    if (At_SubscribeUrcs(UrcReceived) != 0)
+    {
+        printk("BENCHMARK {\"test\":\"urc_latency\",\"skipped\":\"subscribe failed\"}\n");
+        return;
+    }
+
+    struct Measurement measurement;
+    uint32_t dropped = 0;
+
+    ResetMeasurement(&measurement);
+
+    for (uint32_t i = 0; i < CONFIG_BENCHMARK_ITERATIONS; i++)
+    {
+        uint32_t start = k_cycle_get_32();
+
+        if ((Emulator_SendUrc("+BENCHMARK: 1") != 0) || (k_sem_take(&urcSemaphore, K_MSEC(100)) != 0))
+        {
+            dropped++;
+            continue;
+        }
+
+        AddSample(&measurement, urcReceived - start);
+    }
+
+    printk("BENCHMARK {\"test\":\"urc_latency\",\"dropped\":%u,", dropped);
+    PrintMeasurement(&measurement);
+    printk("}\n");
+#else
+    printk("BENCHMARK {\"test\":\"urc_latency\",\"skipped\":\"requires the emulator\"}\n");
+#endif
+}
+
+/**
+ * \brief Transfers an exact amount of data on a socket
+ *
+ * \param fd
+ *      The socket
+ * \param *data
+ *      The data to transfer
+ * \param length
+ *      The amount of data to transfer
+ * \param receive
+ *      Whether to receive rather than send
+ *
+ * \return true
+ *      Data transferred
+ * \return false
+ *      Failed to transfer data
+ */
+static bool TransferAll(int fd, uint8_t *data, size_t length, bool receive)
+{
+    while (length > 0)
+    {
+        ssize_t result = receive ? recv(fd, data, length, 0) : send(fd, data, length, 0);
+
+        if (result <= 0)
+        {
+            return false;
+        }
+
+        data += result;
+        length -= result;
+    }
+
+    return true;
+}
+
+#if CONFIG_SECURE_SERVICES_EMULATOR
+/**
+ * \brief Serves socket benchmark clients on the loopback address
+ *
+ * \param *p1
+ *      The listening socket
+ * \param *p2
+ *      Unused
+ * \param *p3
+ *      Unused
+ *
+ * \return none
+ */
+static void RunServer(void *p1, void *p2, void *p3)
+{
+    (void)p2;
+    (void)p3;
+
+    int listener = (int)(intptr_t)p1;
+
+    k_sem_give(&serverReady);
+
+    while (true)
+    {
+        int client = accept(listener, NULL, NULL);
+
+        if (client < 0)
+        {
+            continue;
+        }
+
+        uint8_t header[5];
+
+        if (TransferAll(client, header, sizeof(header), true))
+        {
+            uint32_t remaining = sys_get_be32(&(header[1]));
+            bool receive = (header[0] == 'S');
+
+            // Either swallow everything the client sends and acknowledge it,
+            // or send the client what it asked for
+            while (remaining > 0)
+            {
+                size_t length = MIN(remaining, sizeof(serverBuffer));
+
+                if (!TransferAll(client, serverBuffer, length, receive))
+                {
+                    break;
+                }
+
+                remaining -= length;
+            }
+
+            if (receive && (remaining == 0))
+            {
+                TransferAll(client, header, 1, false);
+            }
+        }
+
+        close(client);
+    }
+}
+
+/**
+ * \brief Starts the loopback socket benchmark server
+ *
+ * \param none
+ *
+ * \return true
+ *      Server started
+ * \return false
+ *      Failed to start the server
+ */
+static bool StartServer(void)
+{
+    int listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if (listener < 0)
+    {
+        return false;
+    }
+
+    int enable = 1;
+
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_BENCHMARK_PORT)
+    };
+
+    inet_pton(AF_INET, CONFIG_BENCHMARK_SERVER, &(address.sin_addr));
+
+    if ((bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0) || (listen(listener, 1) != 0))
+    {
+        close(listener);
+
+        return false;
+    }
+
+    k_thread_create(&serverThread, serverStack, K_THREAD_STACK_SIZEOF(serverStack), RunServer, (void *)(intptr_t)listener, NULL, NULL, BENCHMARK_CALLER_PRIORITY, 0, K_NO_WAIT);
+
+    k_sem_take(&serverReady, K_FOREVER);
+
+    return true;
+}
+#endif
+
+/**
+ * \brief Measures one socket transfer
+ *
+ * \param *server
+ *      The server's address
+ * \param transmit
+ *      Whether to send to the server rather than receive from it
+ * \param size
+ *      The payload size to use for each call
+ *
+ * \return none
+ */
+static void MeasureTransfer(const struct sockaddr_in *server, bool transmit, size_t size)
+{
+    const char *direction = transmit ? "send" : "recv";
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if (fd < 0)
+    {
+        printk("BENCHMARK {\"test\":\"socket\",\"direction\":\"%s\",\"size\":%u,\"error\":%d}\n", direction, (uint32_t)size, errno);
+        return;
+    }
+
+    if (connect(fd, (const struct sockaddr *)server, sizeof(*server)) != 0)
+    {
+        printk("BENCHMARK {\"test\":\"socket\",\"direction\":\"%s\",\"size\":%u,\"error\":%d}\n", direction, (uint32_t)size, errno);
+        close(fd);
+        return;
+    }
+
+    uint8_t header[5];
+
+    header[0] = transmit ? 'S' : 'R';
+    sys_put_be32(CONFIG_BENCHMARK_SOCKET_BYTES, &(header[1]));
+
+    uint32_t start = k_cycle_get_32();
+    int64_t startTime = k_uptime_get();
+
+    bool success = TransferAll(fd, header, sizeof(header), false);
+
+    uint32_t remaining = CONFIG_BENCHMARK_SOCKET_BYTES;
+    uint32_t operations = 0;
+
+    // Move the data in payload-sized calls
+    while (success && (remaining > 0))
+    {
+        size_t length = MIN(remaining, size);
+
+        ssize_t result = transmit ? send(fd, buffer, length, 0) : recv(fd, buffer, length, 0);
+
+        if (result <= 0)
+        {
+            success = false;
+            break;
+        }
+
+        remaining -= result;
+        operations++;
+    }
+
+    // Wait for the server to acknowledge everything it received
+    if (success && transmit)
+    {
+        success = TransferAll(fd, header, 1, true);
+    }
+
+    uint32_t cycles = k_cycle_get_32() - start;
+    int64_t duration = k_uptime_get() - startTime;
+
+    close(fd);
+
+    if (!success)
+    {
+        printk("BENCHMARK {\"test\":\"socket\",\"direction\":\"%s\",\"size\":%u,\"error\":%d}\n", direction, (uint32_t)size, errno);
+        return;
+    }
+
+    // The cycle counter is more precise but can wrap, so only use it for
+    // short transfers
+    uint64_t microseconds = (duration < 1000) ? k_cyc_to_us_floor64(cycles) : ((uint64_t)duration * USEC_PER_MSEC);
+
+    printk(
+        "BENCHMARK {\"test\":\"socket\",\"direction\":\"%s\",\"size\":%u,\"bytes\":%u,\"calls\":%u,\"duration_us\":%u,\"bytes_per_second\":%u}\n",
+        direction,
+        (uint32_t)size,
+        (uint32_t)CONFIG_BENCHMARK_SOCKET_BYTES,
+        operations,
+        (uint32_t)microseconds,
+        (microseconds > 0) ? (uint32_t)(((uint64_t)CONFIG_BENCHMARK_SOCKET_BYTES * USEC_PER_SEC) / microseconds) : 0
+    );
+}
+
+/**
+ * \brief Measures socket throughput across payload sizes
+ *
+ * \param none
+ *
+ * \return none
+ */
+static void MeasureSockets(void)
+{
+    if (strlen(CONFIG_BENCHMARK_SERVER) == 0)
+    {
+        printk("BENCHMARK {\"test\":\"socket\",\"skipped\":\"no server\"}\n");
+        return;
+    }
+
+#if CONFIG_SECURE_SERVICES_EMULATOR
+    if (!StartServer())
+    {
+        printk("BENCHMARK {\"test\":\"socket\",\"skipped\":\"server failed\",\"error\":%d}\n", errno);
+        return;
+    }
+#endif
+
+    struct sockaddr_in server = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_BENCHMARK_PORT)
+    };
+
+    if (inet_pton(AF_INET, CONFIG_BENCHMARK_SERVER, &(server.sin_addr)) != 1)
+    {
+        printk("BENCHMARK {\"test\":\"socket\",\"skipped\":\"invalid server\"}\n");
+        return;
+    }
+
+    memset(buffer, 0xA5, sizeof(buffer));
+
+    for (size_t size = 64; size <= sizeof(buffer); size *= 4)
+    {
+        MeasureTransfer(&server, true, size);
+        MeasureTransfer(&server, false, size);
+    }
+}
+
+void main(void)
+{
+    printk(
+        "BENCHMARK {\"test\":\"info\",\"board\":\"%s\",\"abi\":\"%s\",\"emulator\":%s,\"sched_lock\":%s,\"channels\":%u,\"iterations\":%u}\n",
+        CONFIG_BOARD,
+        BENCHMARK_ABI_VERSION,
+        IS_ENABLED(CONFIG_SECURE_SERVICES_EMULATOR) ? "true" : "false",
+        GetSchedLock(),
+        SECURE_SERVICE_CHANNEL_COUNT,
+        CONFIG_BENCHMARK_ITERATIONS
+    );
+
+    benchmarkSocket = Net_Socket(AF_INET, SOCK_DGRAM, 0);
+
+    MeasureLatency();
+    MeasureThroughput();
+    MeasureUrcLatency();
+    MeasureSockets();
+
+    if (benchmarkSocket >= 0)
+    {
+        Net_Close(benchmarkSocket);
+    }
+
+    printk("BENCHMARK {\"test\":\"done\"}\n");
+}
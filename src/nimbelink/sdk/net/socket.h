@@ -0,0 +1,327 @@
+/**
+ * \file
+ *
+ * \brief Provides socket operations beyond those Zephyr offers for offloaded
+ *        sockets
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <net/socket.h>
+
+/**
+ * \brief The socket option level for NimbeLink socket options
+ *
+ *  These options are handled by the SDK itself, without involving the Secure
+ *  stack.
+ */
+#define SOL_NIMBELINK               0x4E4C
+
+/**
+ * \brief Merges small writes on a stream socket
+ *
+ *  The option value is an int with how many bytes to collect before sending
+ *  them, limited to CONFIG_NIMBELINK_SOCKETS_TX_COALESCE_SIZE. A value of 0
+ *  turns merging off, which is the default.
+ */
+#define NL_SO_TX_COALESCE           1
+
+/**
+ * \brief How long merged writes can wait before being sent anyway
+ *
+ *  The option value is an int with the time in milliseconds.
+ */
+#define NL_SO_TX_COALESCE_TIMEOUT   2
+
+/**
+ * \brief Sends any merged writes immediately
+ *
+ *  The option value is ignored. If the socket can't take all of the data right
+ *  now, this fails with EAGAIN, and the rest is sent later.
+ */
+#define NL_SO_TX_FLUSH              3
+
+/**
+ * \brief A message for batched message operations
+ */
+struct nl_mmsghdr
+{
+    // The message
+    struct msghdr msg_hdr;
+
+    // The number of bytes transferred for the message
+    unsigned int msg_len;
+};
+
+/**
+ * \brief Receives a message from a socket
+ *
+ * \param sock
+ *      The socket
+ * \param *msg
+ *      Where to put the message
+ * \param flags
+ *      Flags for the receive
+ *
+ * \return -1
+ *      Failed to receive the message, see errno
+ * \return ssize_t
+ *      The number of bytes received
+ */
+extern ssize_t nl_recvmsg(int sock, struct msghdr *msg, int flags);
+
+/**
+ * \brief Receives multiple messages from a socket
+ *
+ *  Only the first message will be waited for, if the socket and flags allow
+ *  waiting; every other message will only be received if it is already
+ *  available.
+ *
+ * \param sock
+ *      The socket
+ * \param *msgvec
+ *      Where to put the messages
+ * \param vlen
+ *      The maximum number of messages to receive
+ * \param flags
+ *      Flags for the receive
+ *
+ * \return -1
+ *      Failed to receive any messages, see errno
+ * \return int
+ *      The number of messages received
+ */
+extern int nl_recvmmsg(int sock, struct nl_mmsghdr *msgvec, unsigned int vlen, int flags);
+
+/**
+ * \brief Sends multiple messages on a socket
+ *
+ * \param sock
+ *      The socket
+ * \param *msgvec
+ *      The messages to send
+ * \param vlen
+ *      The number of messages to send
+ * \param flags
+ *      Flags for the send
+ *
+ * \return -1
+ *      Failed to send any messages, see errno
+ * \return int
+ *      The number of messages sent
+ */
+extern int nl_sendmmsg(int sock, struct nl_mmsghdr *msgvec, unsigned int vlen, int flags);
+
+/**
+ * \brief Statistics for the DNS cache
+ */
+struct nl_dns_cache_stats
+{
+    // How many lookups were served from the cache
+    uint32_t hits;
+
+    // How many lookups went to the network
+    uint32_t misses;
+
+    // How many unexpired lookups are cached
+    uint32_t entries;
+};
+
+/**
+ * \brief Removes every lookup from the DNS cache
+ *
+ * \param none
+ *
+ * \return none
+ */
+extern void nl_dns_cache_flush(void);
+
+/**
+ * \brief Gets the DNS cache's statistics
+ *
+ * \param *stats
+ *      Where to store the statistics
+ *
+ * \return none
+ */
+extern void nl_dns_cache_get_stats(struct nl_dns_cache_stats *stats);
+
+/**
+ * \brief How many buckets are in socket call latency histograms
+ */
+#define NL_SOCKET_STATS_BUCKET_COUNT    8
+
+/**
+ * \brief The upper limit of the first latency histogram bucket, in
+ *        microseconds
+ *
+ *  Each following bucket's limit is four times the one before it, and the
+ *  last bucket holds everything else.
+ */
+#define NL_SOCKET_STATS_FIRST_BUCKET_US 64
+
+/**
+ * \brief Secure Service call statistics for offloaded sockets
+ *
+ *  Latencies are in microseconds.
+ */
+struct nl_socket_stats
+{
+    // How many calls were made
+    uint32_t calls;
+
+    // How many calls failed
+    uint32_t errors;
+
+    // How many calls failed with EAGAIN
+    uint32_t eagain;
+
+    // How many bytes were sent or received
+    uint64_t bytes;
+
+    // The shortest call, or UINT32_MAX if there haven't been any
+    uint32_t min_latency;
+
+    // The longest call
+    uint32_t max_latency;
+
+    // The total time spent in calls
+    uint64_t total_latency;
+
+    // How many calls fell into each latency bucket
+    uint32_t histogram[NL_SOCKET_STATS_BUCKET_COUNT];
+};
+
+/**
+ * \brief Gets the statistics for a networking API
+ *
+ * \param api
+ *      The networking API, from enum Net_Api
+ * \param *stats
+ *      Where to store the statistics
+ *
+ * \return -EINVAL
+ *      Invalid API or statistics pointer
+ * \return 0
+ *      Statistics retrieved
+ */
+extern int nl_socket_get_api_stats(uint16_t api, struct nl_socket_stats *stats);
+
+/**
+ * \brief Gets the statistics for a socket
+ *
+ * \param fd
+ *      The socket's file descriptor
+ * \param *stats
+ *      Where to store the statistics
+ *
+ * \return -EINVAL
+ *      Invalid statistics pointer
+ * \return -EBADF
+ *      File descriptor isn't an offloaded socket
+ * \return 0
+ *      Statistics retrieved
+ */
+extern int nl_socket_get_fd_stats(int fd, struct nl_socket_stats *stats);
+
+/**
+ * \brief Resets all socket statistics
+ *
+ * \param none
+ *
+ * \return none
+ */
+extern void nl_socket_reset_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+namespace NimbeLink::Sdk::Net
+{
+    static constexpr const int SolNimbeLink = SOL_NIMBELINK;
+
+    namespace Option
+    {
+        static constexpr const int TxCoalesce = NL_SO_TX_COALESCE;
+        static constexpr const int TxCoalesceTimeout = NL_SO_TX_COALESCE_TIMEOUT;
+        static constexpr const int TxFlush = NL_SO_TX_FLUSH;
+    };
+
+    using MMsgHdr = nl_mmsghdr;
+
+    static inline ssize_t RecvMsg(int sock, struct msghdr *msg, int flags = 0)
+    {
+        return nl_recvmsg(sock, msg, flags);
+    }
+
+    static inline int RecvMMsg(int sock, MMsgHdr *msgvec, unsigned int vlen, int flags = 0)
+    {
+        return nl_recvmmsg(sock, msgvec, vlen, flags);
+    }
+
+    static inline int SendMMsg(int sock, MMsgHdr *msgvec, unsigned int vlen, int flags = 0)
+    {
+        return nl_sendmmsg(sock, msgvec, vlen, flags);
+    }
+
+    namespace DnsCache
+    {
+        using Stats = nl_dns_cache_stats;
+
+        static inline void Flush(void)
+        {
+            nl_dns_cache_flush();
+        }
+
+        static inline Stats GetStats(void)
+        {
+            Stats stats;
+
+            nl_dns_cache_get_stats(&stats);
+
+            return stats;
+        }
+    }
+
+    namespace Stats
+    {
+        using Counters = nl_socket_stats;
+
+        static constexpr const size_t BucketCount = NL_SOCKET_STATS_BUCKET_COUNT;
+        static constexpr const uint32_t FirstBucketUs = NL_SOCKET_STATS_FIRST_BUCKET_US;
+
+        static inline int GetApi(uint16_t api, Counters &stats)
+        {
+            return nl_socket_get_api_stats(api, &stats);
+        }
+
+        static inline int GetFd(int fd, Counters &stats)
+        {
+            return nl_socket_get_fd_stats(fd, &stats);
+        }
+
+        static inline void Reset(void)
+        {
+            nl_socket_reset_stats();
+        }
+    }
+}
+#endif
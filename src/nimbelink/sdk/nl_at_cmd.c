@@ -26,46 +26,47 @@
 
 #include "nimbelink/sdk/secure_services/at.h"
 
-// The callbacks we'll invoke when we get URCs
-static at_cmd_handler_t handlers[1] = {NULL, };
+/**
+ * \brief A notification handler and its URC subscription
+ */
+struct NotificationHandler
+{
+    // The URC subscription
+    struct At_UrcSubscription subscription;
+
+    // The handler to invoke with URCs
+    at_cmd_handler_t handler;
+};
+
+// The handlers we'll invoke when we get URCs
+static struct NotificationHandler handlers[CONFIG_NIMBELINK_AT_CMD_NOTIFICATION_HANDLERS];
 
-// A semaphore for using the callback storage
+// A semaphore for using the handler storage
 static K_SEM_DEFINE(handlerSemaphore, 1, 1);
 
 /**
  * \brief Handles an incoming URC notification from the Secure stack
  *
- *  The Secure Service API says we should treat the callback we get as if it
- *  were an interrupt, so we will pass the actual handling of reading the URCs
- *  and distributing them to our subscribers off to our work item.
- *
  * \param *buf
  *      The URC
+ * \param *context
+ *      The notification handler
  *
  * \return none
  */
-static void UrcCallback(const char *buf)
+static void UrcCallback(const char *buf, void *context)
 {
-    // Distribute the URC
-    for (size_t i = 0; i < (sizeof(handlers)/sizeof(handlers[0])); i++)
-    {
-        k_sem_take(&handlerSemaphore, K_FOREVER);
-
-        if (handlers[i] != NULL)
-        {
-            handlers[i](buf);
-        }
+    struct NotificationHandler *handler = context;
 
-        k_sem_give(&handlerSemaphore);
-    }
+    handler->handler(buf);
 }
 
 /**
  * \brief Initializes the AT command module
  *
  *  The AT command interface is always available via the Secure Service APIs,
- *  so there's nothing to be done as far as initializing it. We will also
- *  handle URCs from it as the single sink, so we will set that up.
+ *  so there's nothing to be done as far as initializing it. Each notification
+ *  handler subscribes to URCs on its own when it's set.
  *
  * \param none
  *
@@ -74,9 +75,6 @@ static void UrcCallback(const char *buf)
  */
 int at_cmd_init(void)
 {
-    // Subscribe to the Secure stack's URC notifications
-    At_SubscribeUrcs(UrcCallback);
-
     return 0;
 }
 
@@ -273,12 +271,37 @@ void at_cmd_set_notification_handler(at_cmd_handler_t handler)
 
     k_sem_take(&handlerSemaphore, K_FOREVER);
 
-    for (size_t i = 0; i < (sizeof(handlers)/sizeof(handlers[0])); i++)
+    // If this handler is already set, don't give it the URCs twice
+    for (size_t i = 0; i < ARRAY_SIZE(handlers); i++)
+    {
+        if (handlers[i].handler == handler)
+        {
+            k_sem_give(&handlerSemaphore);
+
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < ARRAY_SIZE(handlers); i++)
     {
         // If this handler isn't set, use it
-        if (handlers[i] == NULL)
+        if (handlers[i].handler == NULL)
         {
-            handlers[i] = handler;
+            handlers[i] = (struct NotificationHandler){
+                .subscription = {
+                    .prefix = "",
+                    .handler = UrcCallback,
+                    .context = &(handlers[i])
+                },
+                .handler = handler
+            };
+
+            // If we couldn't subscribe, free the slot back up
+            if (At_AddUrcSubscription(&(handlers[i].subscription)) != 0)
+            {
+                handlers[i].handler = NULL;
+            }
+
             break;
         }
     }
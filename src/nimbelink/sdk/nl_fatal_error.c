@@ -18,6 +18,7 @@
 #include <logging/log_ctrl.h>
 #include <sys/util.h>
 
+#include "nimbelink/sdk/secure_services/call.h"
 #include "nimbelink/sdk/secure_services/kernel.h"
 
 LOG_MODULE_REGISTER(fatal_error, LOG_LEVEL_INF);
@@ -40,5 +41,10 @@ void k_sys_fatal_error_handler(unsigned int reason, const z_arch_esf_t *esf)
     (void)esf;
     (void)reason;
 
+#if CONFIG_SECURE_SERVICES_TRACE
+    // Note what we were talking to the Secure firmware about
+    DumpSecureServiceTrace();
+#endif
+
     LOG_PANIC();
 }
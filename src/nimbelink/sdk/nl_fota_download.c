@@ -18,10 +18,10 @@
 #include <string.h>
 
 #include <modem/at_cmd.h>
-#include <modem/at_notif.h>
 #include <net/fota_download.h>
 
 #include "nimbelink/sdk/cell/at/cme.h"
+#include "nimbelink/sdk/secure_services/at.h"
 
 // A callback to invoke with events
 static fota_download_callback_t callback = NULL;
@@ -49,17 +49,25 @@ static inline void SendEvent(const struct fota_download_evt *event)
     }
 }
 
+static void UrcCallback(const char *urc, void *context);
+
+// Our subscription to DFU URCs
+static struct At_UrcSubscription urcSubscription = {
+    .prefix = "DFU: ",
+    .handler = UrcCallback
+};
+
 /**
- * \brief Handles URCs from the AT interface
+ * \brief Handles DFU URCs from the AT interface
  *
- * \param *context
- *      A context
  * \param *urc
  *      The incoming URC
+ * \param *context
+ *      Unused
  *
  * \return none
  */
-static void UrcCallback(void *context, const char *urc)
+static void UrcCallback(const char *urc, void *context)
 {
     (void)context;
 
@@ -69,12 +77,6 @@ static void UrcCallback(void *context, const char *urc)
         return;
     }
 
-    // If this doesn't look like a DFU URC, ignore this
-    if (strncmp(urc, "DFU: ", 4) != 0)
-    {
-        return;
-    }
-
     // Skip the URC's heading
     const char *start = strchr(urc, ' ');
 
@@ -177,6 +179,10 @@ static void UrcCallback(void *context, const char *urc)
  * \param client_callback
  *      A callback to register for events
  *
+ * \return -EINVAL
+ *      Invalid callback
+ * \return -ENOMEM
+ *      Failed to subscribe to DFU URCs
  * \return 0
  *      FOTA download initialized
  */
@@ -187,7 +193,14 @@ int fota_download_init(fota_download_callback_t client_callback)
         return -EINVAL;
     }
 
-    at_notif_register_handler(NULL, UrcCallback);
+    // Only DFU URCs will be given to us, and being initialized again doesn't
+    // need a second subscription
+    int32_t result = At_AddUrcSubscription(&urcSubscription);
+
+    if ((result != 0) && (result != -EALREADY))
+    {
+        return result;
+    }
 
     callback = client_callback;
 
@@ -19,9 +19,9 @@
  */
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
-#include <bsd_limits.h>
 #include <device.h>
 #include <init.h>
 #include <net/socket.h>
@@ -29,291 +29,1785 @@
 #include <sockets_internal.h>
 #include <zephyr.h>
 
+#if CONFIG_NIMBELINK_SOCKETS_STATS_SHELL
+#include <shell/shell.h>
+#endif
+
+// The emulated Secure firmware doesn't come with the BSD library's limits, so
+// use the emulator's own socket count
+#if CONFIG_SECURE_SERVICES_EMULATOR
+#define BSD_MAX_SOCKET_COUNT    CONFIG_SECURE_SERVICES_EMULATOR_SOCKET_COUNT
+#else
+#include <bsd_limits.h>
+#endif
+
+#include "nimbelink/sdk/net/socket.h"
 #include "nimbelink/sdk/secure_services/kernel.h"
 #include "nimbelink/sdk/secure_services/net.h"
+#include "nimbelink/sdk/secure_services/zephyr/histogram.h"
+
+#define OBJ_TO_FD(context)  (((struct nl_socket *)context)->sd)
+
+/**
+ * \brief Non-Secure state for an offloaded socket
+ */
+struct nl_socket
+{
+    // Whether or not this state is in use
+    bool used;
+
+    // The Zephyr file descriptor
+    int fd;
+
+    // The Secure socket descriptor
+    int sd;
+
+    // The socket's type
+    int type;
+
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+    // A lock for the read-ahead buffer
+    struct k_mutex rxLock;
+
+    // Where the unread data in the read-ahead buffer starts
+    size_t rxOffset;
+
+    // Where the unread data in the read-ahead buffer ends
+    size_t rxLength;
+
+    // The read-ahead buffer
+    uint8_t rxBuffer[CONFIG_NIMBELINK_SOCKETS_READ_AHEAD_SIZE];
+#endif
 
-#define FD_TO_OBJ(fd)       ((void *)(fd + 1))
-#define OBJ_TO_FD(context)  (((int)context) - 1)
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+    // A lock for the transmit buffer
+    struct k_mutex txLock;
+
+    // Work for flushing the transmit buffer after a timeout
+    struct k_delayed_work txWork;
+
+    // How much data to collect before sending it, or 0 if not coalescing
+    size_t txThreshold;
+
+    // How long to hold data before sending it anyway, in milliseconds
+    int32_t txTimeout;
+
+    // An error from flushing the transmit buffer in the background
+    int txError;
+
+    // How much data is in the transmit buffer
+    size_t txLength;
+
+    // The transmit buffer
+    uint8_t txBuffer[CONFIG_NIMBELINK_SOCKETS_TX_COALESCE_SIZE];
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+    // The socket's Secure Service call statistics
+    struct nl_socket_stats stats;
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_POLL_PREPARE
+    // A signal raised when the Secure stack notifies us of readiness changes
+    struct k_poll_signal pollSignal;
+
+    // A timer for raising the signal anyway, in case a notification is missed
+    struct k_timer pollTimer;
+
+    // Whether or not the socket added an event during the current poll()
+    bool pollPrepared;
+
+    // The socket's events, if it was already ready during the current poll()
+    short pollRevents;
+#endif
+};
+
+// State for each of our sockets
+static struct nl_socket sockets[BSD_MAX_SOCKET_COUNT];
+
+// Our sockets' state by Zephyr file descriptor
+//
+// This lets us translate file descriptors without going through Zephyr's file
+// descriptor table, which is worth it for poll().
+static struct nl_socket *fdSockets[CONFIG_POSIX_MAX_FDS];
+
+// A lock for allocating socket state
+static K_MUTEX_DEFINE(socketsLock);
 
 /**
  * \brief Chicken, meet egg
  */
 static const struct socket_op_vtable nl_socket_op_vtable;
 
-static int nl_socket_socket(int family, int type, int proto)
+#if CONFIG_NIMBELINK_SOCKETS_POLL_PREPARE
+static void nl_socket_poll_recheck(struct k_timer *timer);
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+static void nl_socket_tx_timeout(struct k_work *work);
+
+// A queue for flushing transmit buffers in the background
+//
+// Flushes can block on the Secure stack, so they get their own queue rather
+// than holding up the system work queue.
+static struct k_work_q txQueue;
+
+static K_THREAD_STACK_DEFINE(txStack, CONFIG_NIMBELINK_SOCKETS_TX_COALESCE_STACK_SIZE);
+
+/**
+ * \brief Work for finding out when earlier transmit queue work is done
+ */
+struct nl_socket_tx_barrier
 {
-    int result = Net_Socket(
-        family,
-        type,
-        proto
-    );
+    // The work to queue
+    struct k_work work;
+
+    // Given once the work runs
+    struct k_sem done;
+};
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+// How many networking APIs there are
+#define NET_API_COUNT                   (Net_Api_Fcntl + 1)
+
+// Secure Service call statistics for each networking API
+static struct nl_socket_stats apiStats[NET_API_COUNT];
+
+// A lock for our statistics
+static struct k_spinlock statsLock;
+
+/**
+ * \brief Clears statistics
+ *
+ * \param *stats
+ *      The statistics to clear
+ *
+ * \return none
+ */
+static void nl_socket_stats_clear(struct nl_socket_stats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    stats->min_latency = UINT32_MAX;
+}
+
+/**
+ * \brief Records a call in statistics
+ *
+ *  The statistics lock must be held.
+ *
+ * \param *stats
+ *      The statistics
+ * \param api
+ *      The networking API
+ * \param result
+ *      The result of the call
+ * \param error
+ *      The call's errno, if it failed
+ * \param latency
+ *      How long the call took, in microseconds
+ *
+ * \return none
+ */
+static void nl_socket_stats_add(struct nl_socket_stats *stats, uint16_t api, int result, int error, uint32_t latency)
+{
+    stats->calls++;
 
     if (result < 0)
     {
-        Kernel_Errno();
+        stats->errors++;
+
+        if ((error == EAGAIN) || (error == EWOULDBLOCK))
+        {
+            stats->eagain++;
+        }
+    }
+    else if ((api == Net_Api_Recv) ||
+             (api == Net_Api_RecvFrom) ||
+             (api == Net_Api_Send) ||
+             (api == Net_Api_SendTo))
+    {
+        stats->bytes += result;
     }
 
-    return result;
+    stats->total_latency += latency;
+    stats->min_latency = MIN(stats->min_latency, latency);
+    stats->max_latency = MAX(stats->max_latency, latency);
+
+    AddLatencyHistogram(stats->histogram, NL_SOCKET_STATS_BUCKET_COUNT, NL_SOCKET_STATS_FIRST_BUCKET_US, latency);
 }
 
-static int nl_socket_close(void *context)
+/**
+ * \brief Records a networking Secure Service call
+ *
+ * \param *context
+ *      The socket the call was for, if any
+ * \param api
+ *      The networking API
+ * \param result
+ *      The result of the call
+ * \param start
+ *      The cycle count when the call started
+ *
+ * \return none
+ */
+static void nl_socket_stats_record(void *context, uint16_t api, int result, uint32_t start)
 {
-    int fd = OBJ_TO_FD(context);
+    uint32_t latency = k_cyc_to_us_floor32(k_cycle_get_32() - start);
 
-    int result = Net_Close(
-        fd
-    );
+    int error = (result < 0) ? errno : 0;
 
-    if (result < 0)
+    k_spinlock_key_t key = k_spin_lock(&statsLock);
+
+    if (api < NET_API_COUNT)
     {
-        Kernel_Errno();
+        nl_socket_stats_add(&(apiStats[api]), api, result, error, latency);
     }
 
-    return result;
+    if (context != NULL)
+    {
+        nl_socket_stats_add(&(((struct nl_socket *)context)->stats), api, result, error, latency);
+    }
+
+    k_spin_unlock(&statsLock, key);
 }
+#endif
 
-static int nl_socket_accept(void *context, struct sockaddr *addr, socklen_t *addrlen)
+/**
+ * \brief Allocates state for a socket
+ *
+ * \param fd
+ *      The Zephyr file descriptor
+ * \param sd
+ *      The Secure socket descriptor
+ * \param type
+ *      The socket's type
+ *
+ * \return NULL
+ *      Failed to allocate state
+ * \return struct nl_socket *
+ *      The socket's state
+ */
+static struct nl_socket *nl_socket_allocate(int fd, int sd, int type)
 {
-    int fd = OBJ_TO_FD(context);
+    struct nl_socket *socket = NULL;
 
-    int result = Net_Accept(
-        fd,
-        addr,
-        addrlen
-    );
+    k_mutex_lock(&socketsLock, K_FOREVER);
 
-    if (result < 0)
+    for (size_t i = 0; i < (sizeof(sockets)/sizeof(sockets[0])); i++)
     {
-        Kernel_Errno();
+        if (!sockets[i].used)
+        {
+            socket = &(sockets[i]);
+
+            socket->used = true;
+            socket->fd = fd;
+            socket->sd = sd;
+            socket->type = type;
+
+        #if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+            k_mutex_init(&(socket->rxLock));
+
+            socket->rxOffset = 0;
+            socket->rxLength = 0;
+        #endif
+
+        #if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+            k_mutex_init(&(socket->txLock));
+            k_delayed_work_init(&(socket->txWork), nl_socket_tx_timeout);
+
+            socket->txThreshold = 0;
+            socket->txTimeout = CONFIG_NIMBELINK_SOCKETS_TX_COALESCE_TIMEOUT;
+            socket->txError = 0;
+            socket->txLength = 0;
+        #endif
+
+        #if CONFIG_NIMBELINK_SOCKETS_STATS
+            nl_socket_stats_clear(&(socket->stats));
+        #endif
+
+        #if CONFIG_NIMBELINK_SOCKETS_POLL_PREPARE
+            k_poll_signal_init(&(socket->pollSignal));
+            k_timer_init(&(socket->pollTimer), nl_socket_poll_recheck, NULL);
+
+            socket->pollPrepared = false;
+            socket->pollRevents = 0;
+        #endif
+
+            fdSockets[fd] = socket;
+
+            break;
+        }
     }
 
-    return result;
+    k_mutex_unlock(&socketsLock);
+
+    return socket;
 }
 
-static int nl_socket_bind(void *context, const struct sockaddr *addr, socklen_t addrlen)
+/**
+ * \brief Frees a socket's state
+ *
+ * \param *socket
+ *      The socket's state
+ *
+ * \return none
+ */
+static void nl_socket_free(struct nl_socket *socket)
 {
-    int fd = OBJ_TO_FD(context);
+#if CONFIG_NIMBELINK_SOCKETS_POLL_PREPARE
+    k_timer_stop(&(socket->pollTimer));
+#endif
 
-    int result = Net_Bind(
-        fd,
-        addr,
-        addrlen
-    );
+    k_mutex_lock(&socketsLock, K_FOREVER);
 
-    if (result < 0)
-    {
-        Kernel_Errno();
-    }
+    fdSockets[socket->fd] = NULL;
 
-    return result;
+    socket->used = false;
+
+    k_mutex_unlock(&socketsLock);
 }
 
-static int nl_socket_listen(void *context, int backlog)
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+/**
+ * \brief Gets how much data is waiting in a socket's read-ahead buffer
+ *
+ *  This doesn't take the read-ahead lock, so the result is only a snapshot.
+ *
+ * \param *socket
+ *      The socket
+ *
+ * \return size_t
+ *      How much data is waiting
+ */
+static inline size_t nl_socket_read_ahead_available(const struct nl_socket *socket)
 {
-    int fd = OBJ_TO_FD(context);
+    return socket->rxLength - socket->rxOffset;
+}
+#endif
 
-    int result = Net_Listen(
-        fd,
-        backlog
-    );
+/**
+ * \brief Calls a networking secure service
+ *
+ *  If the call fails, errno will be set to the reason for the failure.
+ *
+ * \param *context
+ *      The socket the call is for, if any
+ * \param api
+ *      The networking API
+ * \param *parameters
+ *      Parameters for the call
+ * \param size
+ *      The size of the parameters
+ *
+ * \return int
+ *      The result of the call
+ */
+static int nl_socket_call(void *context, uint16_t api, void *parameters, uint32_t size)
+{
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+    uint32_t start = k_cycle_get_32();
+#else
+    (void)context;
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_RESPONSE_ERRNO
+    int32_t errnoValue;
+
+    int result = Net_CallWithErrno(api, parameters, size, &errnoValue);
+
+    // If the Secure firmware gave us the errno along with the response, use
+    // that
+    if ((result < 0) && (errnoValue != NET_ERRNO_UNSET))
+    {
+        errno = errnoValue;
+    }
+    else if (result < 0)
+    {
+        Kernel_Errno();
+    }
+#else
+    int result = CallSecureService(SecureService_Net, api, parameters, size);
 
     if (result < 0)
     {
         Kernel_Errno();
     }
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+    nl_socket_stats_record(context, api, result, start);
+#endif
 
     return result;
 }
 
-static int nl_socket_connect(void *context, const struct sockaddr *addr, socklen_t addrlen)
+static int nl_socket_socket(int family, int type, int proto)
 {
-    int fd = OBJ_TO_FD(context);
+    struct Net_SocketParameters parameters = {
+        .family = family,
+        .type = type,
+        .proto = proto
+    };
 
-    int result = Net_Connect(
-        fd,
-        addr,
-        addrlen
-    );
+    return nl_socket_call(NULL, Net_Api_Socket, &parameters, sizeof(parameters));
+}
 
-    if (result < 0)
-    {
-        Kernel_Errno();
-    }
+static ssize_t nl_socket_transmit(void *context, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+    int fd = OBJ_TO_FD(context);
 
-    return result;
+    struct Net_SendToParameters parameters = {
+        .fd = fd,
+        .buf = buf,
+        .len = len,
+        .flags = flags,
+        .to = to,
+        .tolen = tolen
+    };
+
+    return nl_socket_call(context, Net_Api_SendTo, &parameters, sizeof(parameters));
 }
 
-static inline int nl_socket_poll(struct pollfd *fds, int nfds, int timeout)
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+/**
+ * \brief Sends everything in a socket's transmit buffer
+ *
+ *  The socket's transmit lock must be held.
+ *
+ *  If the socket can't take more data right now, whatever wasn't sent stays in
+ *  the transmit buffer to be sent later. Any other failure drops the data.
+ *
+ * \param *socket
+ *      The socket
+ *
+ * \return -1
+ *      Failed to send the data, see errno
+ * \return 0
+ *      Transmit buffer flushed
+ */
+static int nl_socket_tx_flush_locked(struct nl_socket *socket)
 {
-    struct pollfd _fds[BSD_MAX_SOCKET_COUNT] = { 0 };
+    size_t sent = 0;
 
-    int changeCount = 0;
+    int result = 0;
 
-    for (int i = 0; i < nfds; i++)
+    // Stream sockets are allowed to take only part of the data, so keep going
+    // until it's all gone
+    while (sent < socket->txLength)
     {
-        _fds[i].events = 0;
-        fds[i].revents = 0;
+        ssize_t count = nl_socket_transmit(socket, &(socket->txBuffer[sent]), socket->txLength - sent, 0, NULL, 0);
 
-        // Per POSIX, negative file descriptors are just ignored, so if this is
-        // negative, ignore it
-        if (fds[i].fd < 0)
+        if (count > 0)
         {
-            _fds[i].fd = fds[i].fd;
+            sent += count;
             continue;
         }
 
-        void *context = z_get_fd_obj(
-            fds[i].fd,
-            (const struct fd_op_vtable *)&nl_socket_op_vtable,
-            ENOTSUP
-        );
-
-        // If we found the object, great, note its translated file descriptor
-        if (context != NULL)
-        {
-            _fds[i].fd = OBJ_TO_FD(context);
-        }
-        // Else, note that's an invalid file descriptor
-        else
+        // If the socket simply isn't taking data right now, keep what's left
+        // for later
+        if ((count == 0) || (errno == EAGAIN) || (errno == EWOULDBLOCK))
         {
-            fds[i].revents = POLLNVAL;
-            changeCount++;
-        }
+            errno = EAGAIN;
 
-        if (fds[i].events & POLLIN)
-        {
-            _fds[i].events |= POLLIN;
+            result = -1;
+            break;
         }
 
-        if (fds[i].events & POLLOUT)
-        {
-            _fds[i].events |= POLLOUT;
-        }
-    }
+        // Otherwise, the rest of the data is lost
+        sent = socket->txLength;
 
-    // If things changed above, that means not all of the file descriptors were
-    // valid
-    if (changeCount > 0)
-    {
-        return changeCount;
+        result = -1;
+        break;
     }
 
-    int result = Net_Poll(
-        _fds,
-        nfds,
-        timeout
-    );
+    // Move anything still waiting to the front of the buffer
+    memmove(socket->txBuffer, &(socket->txBuffer[sent]), socket->txLength - sent);
 
-    if (result < 0)
+    socket->txLength -= sent;
+
+    return result;
+}
+
+/**
+ * \brief Makes sure data waiting in a socket's transmit buffer gets sent
+ *
+ *  The socket's transmit lock must be held.
+ *
+ * \param *socket
+ *      The socket
+ *
+ * \return none
+ */
+static void nl_socket_tx_schedule_locked(struct nl_socket *socket)
+{
+    // If the buffer is empty, nothing needs a timeout, and otherwise don't let
+    // the oldest data wait too long
+    if (socket->txLength == 0)
     {
-        Kernel_Errno();
+        k_delayed_work_cancel(&(socket->txWork));
     }
-
-    for (int i = 0; i < nfds; i++)
+    else if (!k_delayed_work_pending(&(socket->txWork)))
     {
-        fds[i].revents = _fds[i].revents;
+        k_delayed_work_submit_to_queue(&txQueue, &(socket->txWork), K_MSEC(socket->txTimeout));
     }
-
-    return result;
 }
 
-static int nl_socket_setsockopt(void *context, int level, int optname, const void *optval, socklen_t optlen)
+/**
+ * \brief Sends everything in a socket's transmit buffer
+ *
+ * \param *socket
+ *      The socket
+ *
+ * \return -1
+ *      Failed to send the data, see errno
+ * \return 0
+ *      Transmit buffer flushed
+ */
+static int nl_socket_tx_flush(struct nl_socket *socket)
 {
-    int fd = OBJ_TO_FD(context);
+    k_mutex_lock(&(socket->txLock), K_FOREVER);
 
-    int result = Net_SetSockOpt(
-        fd,
-        level,
-        optname,
-        optval,
-        optlen
-    );
+    int result = nl_socket_tx_flush_locked(socket);
 
-    if (result < 0)
-    {
-        Kernel_Errno();
-    }
+    nl_socket_tx_schedule_locked(socket);
+
+    k_mutex_unlock(&(socket->txLock));
 
     return result;
 }
 
-static int nl_socket_getsockopt(void *context, int level, int optname, void *optval, socklen_t *optlen)
+/**
+ * \brief Signals that the transmit queue reached a barrier
+ *
+ * \param *work
+ *      The barrier's work
+ *
+ * \return none
+ */
+static void nl_socket_tx_barrier_done(struct k_work *work)
 {
-    int fd = OBJ_TO_FD(context);
-
-    int result = Net_GetSockOpt(
-        fd,
-        level,
-        optname,
-        optval,
-        optlen
-    );
-
-    if (result < 0)
-    {
-        Kernel_Errno();
-    }
+    struct nl_socket_tx_barrier *barrier = CONTAINER_OF(work, struct nl_socket_tx_barrier, work);
 
-    return result;
+    k_sem_give(&(barrier->done));
 }
 
-static ssize_t nl_socket_recvfrom(void *context, void *buf, unsigned int len, int flags, struct sockaddr *from, socklen_t *fromlen)
+/**
+ * \brief Flushes a socket's transmit buffer once its data has waited too long
+ *
+ * \param *work
+ *      The socket's transmit work
+ *
+ * \return none
+ */
+static void nl_socket_tx_timeout(struct k_work *work)
 {
-    int fd = OBJ_TO_FD(context);
+    struct nl_socket *socket = CONTAINER_OF(work, struct nl_socket, txWork.work);
 
-    int result = Net_RecvFrom(
-        fd,
-        buf,
-        len,
-        flags,
-        from,
-        fromlen
-    );
+    k_mutex_lock(&(socket->txLock), K_FOREVER);
 
-    if (result < 0)
+    // If that failed, let the next writer know, unless the socket simply
+    // wasn't ready for the data, in which case we'll try again later
+    if (socket->used && (nl_socket_tx_flush_locked(socket) != 0) && (errno != EAGAIN))
     {
-        Kernel_Errno();
+        socket->txError = errno;
     }
 
-    return result;
-}
+    nl_socket_tx_schedule_locked(socket);
 
-static ssize_t nl_socket_read(void *context, void *buffer, size_t count)
-{
-    return nl_socket_recvfrom(context, buffer, count, 0, NULL, 0);
+    k_mutex_unlock(&(socket->txLock));
 }
 
-static ssize_t nl_socket_sendto(void *context, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
+/**
+ * \brief Waits for any transmit buffer flush already running in the background
+ *
+ *  The socket's transmit buffer must already be empty, so a running flush
+ *  won't schedule itself again.
+ *
+ * \param *socket
+ *      The socket
+ *
+ * \return none
+ */
+static void nl_socket_tx_wait(struct nl_socket *socket)
 {
-    int fd = OBJ_TO_FD(context);
+    struct nl_socket_tx_barrier barrier;
 
-    int result = Net_SendTo(
-        fd,
-        buf,
-        len,
-        flags,
-        to,
-        tolen
-    );
+    // Make sure the flush won't start later
+    k_delayed_work_cancel(&(socket->txWork));
 
-    if (result < 0)
-    {
-        Kernel_Errno();
-    }
+    // The queue runs its work in order, so once our own work runs, any flush
+    // that was already running or queued is done
+    k_work_init(&(barrier.work), nl_socket_tx_barrier_done);
+    k_sem_init(&(barrier.done), 0, 1);
 
-    return result;
+    k_work_submit_to_queue(&txQueue, &(barrier.work));
+
+    k_sem_take(&(barrier.done), K_FOREVER);
 }
 
-static ssize_t nl_socket_write(void *context, const void *buffer, size_t count)
+/**
+ * \brief Writes data to a socket's transmit buffer
+ *
+ *  The data will be sent once enough has been collected, once the oldest data
+ *  has waited long enough, or once the buffer is explicitly flushed.
+ *
+ * \param *socket
+ *      The socket
+ * \param *buf
+ *      The data to write
+ * \param len
+ *      The amount of data to write
+ *
+ * \return -1
+ *      Failed to write the data, see errno
+ * \return ssize_t
+ *      The amount of data written
+ */
+static ssize_t nl_socket_tx_coalesce(struct nl_socket *socket, const void *buf, size_t len)
+{
+    k_mutex_lock(&(socket->txLock), K_FOREVER);
+
+    // If a previous flush failed, report that now
+    if (socket->txError != 0)
+    {
+        errno = socket->txError;
+        socket->txError = 0;
+
+        k_mutex_unlock(&(socket->txLock));
+
+        return -1;
+    }
+
+    ssize_t result = len;
+
+    // If this won't fit with what we have, send what we have first
+    //
+    // If the socket only took part of it, this might fit now anyway.
+    if ((socket->txLength + len) > sizeof(socket->txBuffer))
+    {
+        if ((nl_socket_tx_flush_locked(socket) != 0) &&
+            ((errno != EAGAIN) || ((socket->txLength + len) > sizeof(socket->txBuffer))))
+        {
+            result = -1;
+            goto Done;
+        }
+    }
+
+    // If this is big enough to go on its own, send it directly
+    if ((socket->txLength == 0) && (len >= socket->txThreshold))
+    {
+        result = nl_socket_transmit(socket, buf, len, 0, NULL, 0);
+        goto Done;
+    }
+
+    memcpy(&(socket->txBuffer[socket->txLength]), buf, len);
+
+    socket->txLength += len;
+
+    // If we've collected enough, send it
+    //
+    // If the socket isn't ready for it, this data is still buffered, so it
+    // will go out later.
+    if ((socket->txLength >= socket->txThreshold) &&
+        (nl_socket_tx_flush_locked(socket) != 0) &&
+        (errno != EAGAIN))
+    {
+        result = -1;
+    }
+
+Done:
+    nl_socket_tx_schedule_locked(socket);
+
+    k_mutex_unlock(&(socket->txLock));
+
+    return result;
+}
+
+/**
+ * \brief Handles a NimbeLink socket option
+ *
+ * \param *socket
+ *      The socket
+ * \param optname
+ *      The option
+ * \param *optval
+ *      The option's value
+ * \param optlen
+ *      The size of the option's value
+ *
+ * \return -1
+ *      Failed to set the option, see errno
+ * \return 0
+ *      Option set
+ */
+static int nl_socket_set_nimbelink_option(struct nl_socket *socket, int optname, const void *optval, socklen_t optlen)
+{
+    switch (optname)
+    {
+        case NL_SO_TX_COALESCE:
+        case NL_SO_TX_COALESCE_TIMEOUT:
+        {
+            if ((optval == NULL) || (optlen != sizeof(int)) || (*(const int *)optval < 0))
+            {
+                errno = EINVAL;
+
+                return -1;
+            }
+
+            // Only stream sockets can have their writes merged
+            if (socket->type != SOCK_STREAM)
+            {
+                errno = ENOPROTOOPT;
+
+                return -1;
+            }
+
+            k_mutex_lock(&(socket->txLock), K_FOREVER);
+
+            if (optname == NL_SO_TX_COALESCE)
+            {
+                socket->txThreshold = MIN((size_t)*(const int *)optval, sizeof(socket->txBuffer));
+            }
+            else
+            {
+                socket->txTimeout = *(const int *)optval;
+            }
+
+            k_mutex_unlock(&(socket->txLock));
+
+            // If that turned coalescing off, don't hold onto anything
+            return (socket->txThreshold == 0) ? nl_socket_tx_flush(socket) : 0;
+        }
+
+        case NL_SO_TX_FLUSH:
+        {
+            return nl_socket_tx_flush(socket);
+        }
+
+        default:
+        {
+            errno = ENOPROTOOPT;
+
+            return -1;
+        }
+    }
+}
+
+/**
+ * \brief Gets a NimbeLink socket option
+ *
+ * \param *socket
+ *      The socket
+ * \param optname
+ *      The option
+ * \param *optval
+ *      Where to put the option's value
+ * \param *optlen
+ *      The size of the option's value
+ *
+ * \return -1
+ *      Failed to get the option, see errno
+ * \return 0
+ *      Option gotten
+ */
+static int nl_socket_get_nimbelink_option(struct nl_socket *socket, int optname, void *optval, socklen_t *optlen)
+{
+    if ((optval == NULL) || (optlen == NULL) || (*optlen < sizeof(int)))
+    {
+        errno = EINVAL;
+
+        return -1;
+    }
+
+    switch (optname)
+    {
+        case NL_SO_TX_COALESCE:
+        {
+            *(int *)optval = socket->txThreshold;
+            break;
+        }
+
+        case NL_SO_TX_COALESCE_TIMEOUT:
+        {
+            *(int *)optval = socket->txTimeout;
+            break;
+        }
+
+        default:
+        {
+            errno = ENOPROTOOPT;
+
+            return -1;
+        }
+    }
+
+    *optlen = sizeof(int);
+
+    return 0;
+}
+#endif
+
+static int nl_socket_close_sd(int sd)
+{
+    struct Net_CloseParameters parameters = {
+        .fd = sd
+    };
+
+    return nl_socket_call(NULL, Net_Api_Close, &parameters, sizeof(parameters));
+}
+
+static int nl_socket_close(void *context)
+{
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+    struct nl_socket *socket = context;
+
+    // Send anything still waiting, and drop whatever the socket won't take
+    k_mutex_lock(&(socket->txLock), K_FOREVER);
+
+    nl_socket_tx_flush_locked(socket);
+
+    socket->txLength = 0;
+
+    k_mutex_unlock(&(socket->txLock));
+
+    // Make sure nothing is still sending in the background before the socket
+    // goes away
+    nl_socket_tx_wait(socket);
+#endif
+
+    int result = nl_socket_close_sd(OBJ_TO_FD(context));
+
+    nl_socket_free(context);
+
+    return result;
+}
+
+static int nl_socket_accept(void *context, struct sockaddr *addr, socklen_t *addrlen)
+{
+    int fd = z_reserve_fd();
+
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    struct Net_AcceptParameters parameters = {
+        .fd = OBJ_TO_FD(context),
+        .addr = addr,
+        .addrlen = addrlen
+    };
+
+    int sd = nl_socket_call(context, Net_Api_Accept, &parameters, sizeof(parameters));
+
+    if (sd < 0)
+    {
+        z_free_fd(fd);
+
+        return -1;
+    }
+
+    // Only stream sockets can be accepted
+    struct nl_socket *socket = nl_socket_allocate(fd, sd, SOCK_STREAM);
+
+    if (socket == NULL)
+    {
+        nl_socket_close_sd(sd);
+        z_free_fd(fd);
+
+        errno = ENFILE;
+
+        return -1;
+    }
+
+    z_finalize_fd(fd, socket, (const struct fd_op_vtable *)&nl_socket_op_vtable);
+
+    return fd;
+}
+
+static int nl_socket_bind(void *context, const struct sockaddr *addr, socklen_t addrlen)
+{
+    int fd = OBJ_TO_FD(context);
+
+    struct Net_BindParameters parameters = {
+        .fd = fd,
+        .addr = addr,
+        .addrlen = addrlen
+    };
+
+    return nl_socket_call(context, Net_Api_Bind, &parameters, sizeof(parameters));
+}
+
+static int nl_socket_listen(void *context, int backlog)
+{
+    int fd = OBJ_TO_FD(context);
+
+    struct Net_ListenParameters parameters = {
+        .fd = fd,
+        .backlog = backlog
+    };
+
+    return nl_socket_call(context, Net_Api_Listen, &parameters, sizeof(parameters));
+}
+
+static int nl_socket_connect(void *context, const struct sockaddr *addr, socklen_t addrlen)
+{
+    int fd = OBJ_TO_FD(context);
+
+    struct Net_ConnectParameters parameters = {
+        .fd = fd,
+        .addr = addr,
+        .addrlen = addrlen
+    };
+
+    return nl_socket_call(context, Net_Api_Connect, &parameters, sizeof(parameters));
+}
+
+#if CONFIG_NIMBELINK_SOCKETS_READINESS_EVENTS
+/**
+ * \brief A thread waiting for socket readiness notifications
+ */
+struct nl_readiness_waiter
+{
+    // Our entry in the list of waiters
+    sys_snode_t node;
+
+    // A semaphore for waking the waiting thread
+    struct k_sem semaphore;
+};
+
+// The threads waiting for socket readiness notifications
+static sys_slist_t readinessWaiters = SYS_SLIST_STATIC_INIT(&readinessWaiters);
+
+// A lock for the list of waiters
+static struct k_spinlock readinessLock;
+
+/**
+ * \brief Handles a socket readiness notification from the Secure stack
+ *
+ * \param fd
+ *      The socket whose readiness changed
+ * \param revents
+ *      The socket's new poll() events
+ *
+ * \return none
+ */
+static void nl_socket_readiness(int32_t fd, int32_t revents)
+{
+#if CONFIG_NIMBELINK_SOCKETS_POLL_PREPARE
+    // Let anyone polling this socket alongside other objects know
+    for (size_t i = 0; i < (sizeof(sockets)/sizeof(sockets[0])); i++)
+    {
+        if (sockets[i].used && (sockets[i].sd == fd))
+        {
+            k_poll_signal_raise(&(sockets[i].pollSignal), revents);
+            break;
+        }
+    }
+#else
+    (void)fd;
+    (void)revents;
+#endif
+
+    // Wake everyone up and let them check their own sockets
+    k_spinlock_key_t key = k_spin_lock(&readinessLock);
+
+    struct nl_readiness_waiter *waiter;
+
+    SYS_SLIST_FOR_EACH_CONTAINER(&readinessWaiters, waiter, node)
+    {
+        k_sem_give(&(waiter->semaphore));
+    }
+
+    k_spin_unlock(&readinessLock, key);
+}
+
+/**
+ * \brief Polls sockets, waiting locally for readiness notifications
+ *
+ *  Each check of the sockets is done without waiting, so the Secure Service
+ *  channel is only held for as long as the check takes.
+ *
+ * \param *fds
+ *      The translated file descriptors to poll
+ * \param nfds
+ *      The number of file descriptors
+ * \param timeout
+ *      How long to wait for a file descriptor to be ready, in milliseconds
+ *
+ * \return int
+ *      The result of the poll
+ */
+static int nl_socket_poll_wait(struct pollfd *fds, int nfds, int timeout)
+{
+    int64_t start = k_uptime_get();
+
+    int result;
+
+    struct nl_readiness_waiter waiter;
+
+    k_sem_init(&(waiter.semaphore), 0, 1);
+
+    // Note we're waiting before we check anything, so we don't miss a
+    // notification that comes in between our check and our wait
+    k_spinlock_key_t key = k_spin_lock(&readinessLock);
+
+    sys_slist_append(&readinessWaiters, &(waiter.node));
+
+    k_spin_unlock(&readinessLock, key);
+
+    while (true)
+    {
+        struct Net_PollParameters parameters = {
+            .fds = fds,
+            .nfds = nfds,
+            .timeout = 0
+        };
+
+        // Drop any wakeup left over from a notification before this check,
+        // since the check covers it, and it would otherwise wake us up again
+        // right away
+        k_sem_reset(&(waiter.semaphore));
+
+        result = nl_socket_call(NULL, Net_Api_Poll, &parameters, sizeof(parameters));
+
+        // If something is ready or went wrong, we're done
+        if (result != 0)
+        {
+            break;
+        }
+
+        int64_t wait = CONFIG_NIMBELINK_SOCKETS_READINESS_RECHECK_INTERVAL;
+
+        // If there's a timeout, don't wait past it
+        if (timeout >= 0)
+        {
+            int64_t remaining = timeout - (k_uptime_get() - start);
+
+            if (remaining <= 0)
+            {
+                break;
+            }
+
+            wait = MIN(wait, remaining);
+        }
+
+        k_sem_take(&(waiter.semaphore), K_MSEC(wait));
+    }
+
+    key = k_spin_lock(&readinessLock);
+
+    sys_slist_find_and_remove(&readinessWaiters, &(waiter.node));
+
+    k_spin_unlock(&readinessLock, key);
+
+    return result;
+}
+#endif
+
+static inline int nl_socket_poll(struct pollfd *fds, int nfds, int timeout)
+{
+    if (nfds < 0)
+    {
+        errno = EINVAL;
+
+        return -1;
+    }
+
+    int count = 0;
+
+    for (int i = 0; i < nfds; i++)
+    {
+        fds[i].revents = 0;
+
+        if (fds[i].fd >= 0)
+        {
+            count++;
+        }
+    }
+
+    // We can't ever have more sockets than this, so there's no point going
+    // further
+    if (count > BSD_MAX_SOCKET_COUNT)
+    {
+        errno = EINVAL;
+
+        return -1;
+    }
+
+    // Where each active file descriptor is in the caller's file descriptors
+    int index[BSD_MAX_SOCKET_COUNT];
+
+    // The translated file descriptors
+    struct pollfd _fds[BSD_MAX_SOCKET_COUNT];
+
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+    // Which sockets already have data waiting in their read-ahead buffers
+    bool readAhead[BSD_MAX_SOCKET_COUNT];
+    int readAheadCount = 0;
+#endif
+
+    int changeCount = 0;
+
+    count = 0;
+
+    for (int i = 0; i < nfds; i++)
+    {
+        // Per POSIX, negative file descriptors are just ignored, so if this is
+        // negative, ignore it
+        if (fds[i].fd < 0)
+        {
+            continue;
+        }
+
+        struct nl_socket *socket = NULL;
+
+        if (fds[i].fd < CONFIG_POSIX_MAX_FDS)
+        {
+            socket = fdSockets[fds[i].fd];
+        }
+
+        // If we didn't find the socket, note that's an invalid file descriptor
+        if (socket == NULL)
+        {
+            fds[i].revents = POLLNVAL;
+            changeCount++;
+
+            continue;
+        }
+
+        index[count] = i;
+
+        _fds[count].fd = socket->sd;
+        _fds[count].events = fds[i].events & (POLLIN | POLLOUT);
+        _fds[count].revents = 0;
+
+    #if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+        readAhead[count] = (fds[i].events & POLLIN) &&
+                           (nl_socket_read_ahead_available(socket) > 0);
+
+        if (readAhead[count])
+        {
+            readAheadCount++;
+        }
+    #endif
+
+        count++;
+    }
+
+    // If things changed above, that means not all of the file descriptors
+    // were valid
+    if (changeCount > 0)
+    {
+        return changeCount;
+    }
+
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+    // If some sockets already have data for the caller, just check on the rest
+    // without waiting
+    if (readAheadCount > 0)
+    {
+        timeout = 0;
+    }
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_READINESS_EVENTS
+    int result = nl_socket_poll_wait(_fds, count, timeout);
+#else
+    struct Net_PollParameters parameters = {
+        .fds = _fds,
+        .nfds = count,
+        .timeout = timeout
+    };
+
+    int result = nl_socket_call(NULL, Net_Api_Poll, &parameters, sizeof(parameters));
+#endif
+
+    for (int i = 0; i < count; i++)
+    {
+        fds[index[i]].revents = _fds[i].revents;
+    }
+
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+    // Sockets with data in their read-ahead buffers are readable, whatever the
+    // Secure stack thinks
+    if ((readAheadCount > 0) && (result >= 0))
+    {
+        result = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            if (readAhead[i])
+            {
+                fds[index[i]].revents |= POLLIN;
+            }
+
+            if (fds[index[i]].revents != 0)
+            {
+                result++;
+            }
+        }
+    }
+#endif
+
+    return result;
+}
+
+#if CONFIG_NIMBELINK_SOCKETS_POLL_PREPARE
+/**
+ * \brief Checks a socket's readiness without waiting
+ *
+ * \param *socket
+ *      The socket
+ * \param events
+ *      The events to check for
+ * \param *revents
+ *      Where to store the socket's ready events
+ *
+ * \return int
+ *      0 if the check was made, otherwise a negative error
+ */
+static int nl_socket_poll_check(struct nl_socket *socket, short events, short *revents)
+{
+    struct pollfd fd = {
+        .fd = socket->sd,
+        .events = events & (POLLIN | POLLOUT),
+        .revents = 0
+    };
+
+    struct Net_PollParameters parameters = {
+        .fds = &fd,
+        .nfds = 1,
+        .timeout = 0
+    };
+
+    if (nl_socket_call(socket, Net_Api_Poll, &parameters, sizeof(parameters)) < 0)
+    {
+        return -errno;
+    }
+
+    *revents = fd.revents;
+
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+    // Sockets with data in their read-ahead buffers are readable, whatever the
+    // Secure stack thinks
+    if ((events & POLLIN) && (nl_socket_read_ahead_available(socket) > 0))
+    {
+        *revents |= POLLIN;
+    }
+#endif
+
+    return 0;
+}
+
+/**
+ * \brief Raises a socket's poll signal, in case a notification was missed
+ *
+ * \param *timer
+ *      The socket's poll timer
+ *
+ * \return none
+ */
+static void nl_socket_poll_recheck(struct k_timer *timer)
+{
+    struct nl_socket *socket = CONTAINER_OF(timer, struct nl_socket, pollTimer);
+
+    k_poll_signal_raise(&(socket->pollSignal), 0);
+}
+
+/**
+ * \brief Prepares a socket for a poll() alongside other objects
+ *
+ *  If the socket is already ready, no event is added, and poll() is told not
+ *  to wait. Otherwise, an event for the socket's readiness signal is added,
+ *  which is also raised at the recheck interval.
+ *
+ * \param *socket
+ *      The socket
+ * \param *pfd
+ *      The socket's poll() entry
+ * \param **pev
+ *      The next free poll event, which will be advanced if used
+ * \param *pevEnd
+ *      The end of the poll events
+ *
+ * \return -EALREADY
+ *      Socket already ready
+ * \return -ENOMEM
+ *      No poll events left
+ * \return int
+ *      0 if an event was added, otherwise a negative error
+ */
+static int nl_socket_poll_prepare(
+    struct nl_socket *socket,
+    struct zsock_pollfd *pfd,
+    struct k_poll_event **pev,
+    struct k_poll_event *pevEnd
+)
+{
+    socket->pollPrepared = false;
+    socket->pollRevents = 0;
+
+    // Clear the signal before we check, so a notification that comes in
+    // between our check and the wait will still wake us
+    k_poll_signal_reset(&(socket->pollSignal));
+
+    short revents;
+
+    int result = nl_socket_poll_check(socket, pfd->events, &revents);
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    if (revents != 0)
+    {
+        socket->pollRevents = revents;
+
+        return -EALREADY;
+    }
+
+    if (*pev == pevEnd)
+    {
+        return -ENOMEM;
+    }
+
+    k_poll_event_init(*pev, K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &(socket->pollSignal));
+
+    (*pev)++;
+
+    // Don't rely entirely on notifications to notice the socket is ready
+    k_timer_start(&(socket->pollTimer), K_MSEC(CONFIG_NIMBELINK_SOCKETS_READINESS_RECHECK_INTERVAL), K_NO_WAIT);
+
+    socket->pollPrepared = true;
+
+    return 0;
+}
+
+/**
+ * \brief Updates a socket's poll() entry after waiting
+ *
+ *  poll() may wait and update the entries again without preparing them again,
+ *  so the socket's event stays in use for the rest of the poll().
+ *
+ * \param *socket
+ *      The socket
+ * \param *pfd
+ *      The socket's poll() entry
+ * \param **pev
+ *      The socket's poll event, if it added one, which will be advanced past
+ *
+ * \return -EAGAIN
+ *      Socket was signaled, but isn't ready, so poll() should try again
+ * \return int
+ *      0 if the entry was updated, otherwise a negative error
+ */
+static int nl_socket_poll_update(struct nl_socket *socket, struct zsock_pollfd *pfd, struct k_poll_event **pev)
+{
+    pfd->revents = 0;
+
+    // If the socket was ready before we waited, just use that
+    if (!socket->pollPrepared)
+    {
+        pfd->revents = socket->pollRevents;
+
+        return 0;
+    }
+
+    struct k_poll_event *event = (*pev)++;
+
+    if (event->state == K_POLL_STATE_NOT_READY)
+    {
+        return 0;
+    }
+
+    // In case we need to wait again, clear the signal and the event before we
+    // check, the same way we did when preparing
+    k_poll_signal_reset(&(socket->pollSignal));
+
+    event->state = K_POLL_STATE_NOT_READY;
+
+    // The notification only tells us something changed, so see what the
+    // socket's state actually is now
+    short revents;
+
+    int result = nl_socket_poll_check(socket, pfd->events, &revents);
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    // If the socket isn't actually ready, wait again
+    if (revents == 0)
+    {
+        k_timer_start(&(socket->pollTimer), K_MSEC(CONFIG_NIMBELINK_SOCKETS_READINESS_RECHECK_INTERVAL), K_NO_WAIT);
+
+        return -EAGAIN;
+    }
+
+    pfd->revents = revents;
+
+    return 0;
+}
+#endif
+
+static int nl_socket_setsockopt(void *context, int level, int optname, const void *optval, socklen_t optlen)
+{
+    int fd = OBJ_TO_FD(context);
+
+    // Our own options never make it to the Secure stack
+    if (level == SOL_NIMBELINK)
+    {
+    #if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+        return nl_socket_set_nimbelink_option(context, optname, optval, optlen);
+    #else
+        errno = ENOPROTOOPT;
+
+        return -1;
+    #endif
+    }
+
+    struct Net_SetSockOptParameters parameters = {
+        .fd = fd,
+        .level = level,
+        .optname = optname,
+        .optval = optval,
+        .optlen = optlen
+    };
+
+    return nl_socket_call(context, Net_Api_SetSockOpt, &parameters, sizeof(parameters));
+}
+
+static int nl_socket_getsockopt(void *context, int level, int optname, void *optval, socklen_t *optlen)
+{
+    int fd = OBJ_TO_FD(context);
+
+    // Our own options never make it to the Secure stack
+    if (level == SOL_NIMBELINK)
+    {
+    #if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+        return nl_socket_get_nimbelink_option(context, optname, optval, optlen);
+    #else
+        errno = ENOPROTOOPT;
+
+        return -1;
+    #endif
+    }
+
+    struct Net_GetSockOptParameters parameters = {
+        .fd = fd,
+        .level = level,
+        .optname = optname,
+        .optval = optval,
+        .optlen = optlen
+    };
+
+    return nl_socket_call(context, Net_Api_GetSockOpt, &parameters, sizeof(parameters));
+}
+
+static ssize_t nl_socket_receive(void *context, void *buf, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen)
+{
+    int fd = OBJ_TO_FD(context);
+
+    // If they don't care who it's from, use the plain receive, whose length
+    // isn't limited to 16 bits
+    if (from == NULL)
+    {
+        struct Net_RecvParameters parameters = {
+            .fd = fd,
+            .buf = buf,
+            .max_len = len,
+            .flags = flags
+        };
+
+        return nl_socket_call(context, Net_Api_Recv, &parameters, sizeof(parameters));
+    }
+
+    // Otherwise, the length has to fit in the receive-from's 16 bits, which
+    // -- like any receive -- is allowed to return fewer bytes than requested
+    struct Net_RecvFromParameters parameters = {
+        .fd = fd,
+        .buf = buf,
+        .len = MIN(len, INT16_MAX),
+        .flags = flags,
+        .from = from,
+        .fromlen = fromlen
+    };
+
+    return nl_socket_call(context, Net_Api_RecvFrom, &parameters, sizeof(parameters));
+}
+
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+/**
+ * \brief Receives data from a stream socket through its read-ahead buffer
+ *
+ *  Small reads pull in as much data as the read-ahead buffer can hold with a
+ *  single Secure Service call and are then served from the buffer until it
+ *  runs dry. Reads at least as large as the buffer skip it once it's empty.
+ *
+ * \param *socket
+ *      The socket
+ * \param *buf
+ *      Where to put the data
+ * \param len
+ *      The maximum amount of data to receive
+ * \param flags
+ *      Flags for the receive
+ *
+ * \return -1
+ *      Failed to receive data, see errno
+ * \return ssize_t
+ *      The amount of data received
+ */
+static ssize_t nl_socket_read_ahead(struct nl_socket *socket, void *buf, size_t len, int flags)
+{
+    k_mutex_lock(&(socket->rxLock), K_FOREVER);
+
+    size_t available = nl_socket_read_ahead_available(socket);
+
+    // If we're out of data, get more
+    if (available == 0)
+    {
+        // If the caller can take at least as much as our buffer could, there's
+        // no point in copying it through our buffer
+        if (len >= sizeof(socket->rxBuffer))
+        {
+            k_mutex_unlock(&(socket->rxLock));
+
+            return nl_socket_receive(socket, buf, len, flags, NULL, NULL);
+        }
+
+        // Take whatever is there -- even if the caller is peeking or waiting
+        // for all of their data -- and sort out their wishes below
+        ssize_t result = nl_socket_receive(
+            socket,
+            socket->rxBuffer,
+            sizeof(socket->rxBuffer),
+            flags & ~(MSG_PEEK | MSG_WAITALL),
+            NULL,
+            NULL
+        );
+
+        if (result <= 0)
+        {
+            k_mutex_unlock(&(socket->rxLock));
+
+            return result;
+        }
+
+        socket->rxOffset = 0;
+        socket->rxLength = result;
+
+        available = result;
+    }
+
+    size_t count = MIN(len, available);
+
+    memcpy(buf, &(socket->rxBuffer[socket->rxOffset]), count);
+
+    // If they're only peeking, leave the data for next time
+    if ((flags & MSG_PEEK) == 0)
+    {
+        socket->rxOffset += count;
+    }
+
+    // If they want all of their data, get the rest directly
+    if (((flags & MSG_WAITALL) != 0) && ((flags & MSG_PEEK) == 0) && (count < len))
+    {
+        ssize_t result = nl_socket_receive(socket, (uint8_t *)buf + count, len - count, flags, NULL, NULL);
+
+        // If that failed, we still got what we got
+        if (result > 0)
+        {
+            count += result;
+        }
+    }
+
+    k_mutex_unlock(&(socket->rxLock));
+
+    return count;
+}
+#endif
+
+static ssize_t nl_socket_recvfrom(void *context, void *buf, unsigned int len, int flags, struct sockaddr *from, socklen_t *fromlen)
+{
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE || CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+    struct nl_socket *socket = context;
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+    // If we're waiting on a response, make sure the request actually went out
+    //
+    // Nothing is buffered unless the socket coalesces writes, so only take the
+    // transmit lock if there's something to send. If the socket isn't ready
+    // for all of it, the rest will go out later, and there might still be
+    // something to read in the meantime.
+    if ((socket->txLength > 0) && (nl_socket_tx_flush(socket) != 0) && (errno != EAGAIN))
+    {
+        return -1;
+    }
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_READ_AHEAD
+    // Stream sockets have no message boundaries to respect, so they can read
+    // ahead
+    if (socket->type == SOCK_STREAM)
+    {
+        return nl_socket_read_ahead(socket, buf, len, flags);
+    }
+#endif
+
+    return nl_socket_receive(context, buf, len, flags, from, fromlen);
+}
+
+static ssize_t nl_socket_read(void *context, void *buffer, size_t count)
+{
+    return nl_socket_recvfrom(context, buffer, count, 0, NULL, 0);
+}
+
+static ssize_t nl_socket_sendto(void *context, const void *buf, size_t len, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+    struct nl_socket *socket = context;
+
+    // Plain writes can be merged, if the socket wants that
+    if ((socket->txThreshold > 0) && (flags == 0) && (to == NULL))
+    {
+        return nl_socket_tx_coalesce(socket, buf, len);
+    }
+
+    // Anything else has to go out after whatever was already written
+    if ((socket->txLength > 0) && (nl_socket_tx_flush(socket) != 0))
+    {
+        return -1;
+    }
+#endif
+
+    return nl_socket_transmit(context, buf, len, flags, to, tolen);
+}
+
+static ssize_t nl_socket_write(void *context, const void *buffer, size_t count)
 {
     return nl_socket_sendto(context, buffer, count, 0, NULL, 0);
 }
 
 static ssize_t nl_socket_sendmsg(void *context, const struct msghdr *msg, int flags)
 {
-    static K_MUTEX_DEFINE(lock);
-    static uint8_t buffer[128];
+    struct nl_socket *socket = context;
+
+    if (msg == NULL)
+    {
+        errno = EINVAL;
+
+        return -1;
+    }
+
+    // If there's only a single buffer, there's nothing to gather, so send it
+    // directly
+    if (msg->msg_iovlen == 1)
+    {
+        return nl_socket_sendto(
+            context,
+            msg->msg_iov[0].iov_base,
+            msg->msg_iov[0].iov_len,
+            flags,
+            msg->msg_name,
+            msg->msg_namelen
+        );
+    }
+
+    size_t length = 0;
+
+    for (int i = 0; i < msg->msg_iovlen; i++)
+    {
+        length += msg->msg_iov[i].iov_len;
+    }
+
+    // Gather the data into a single buffer so the message goes out in a single
+    // `sendto` call -- and, for datagrams, as a single datagram
+    //
+    // Each call has its own buffer, so sockets don't have to wait on each
+    // other.
+    uint8_t buffer[CONFIG_NIMBELINK_SOCKETS_SENDMSG_BUFFER_SIZE];
+
+    if (length <= sizeof(buffer))
+    {
+        length = 0;
+
+        for (int i = 0; i < msg->msg_iovlen; i++)
+        {
+            memcpy(
+                buffer + length,
+                msg->msg_iov[i].iov_base,
+                msg->msg_iov[i].iov_len
+            );
+
+            length += msg->msg_iov[i].iov_len;
+        }
+
+        return nl_socket_sendto(
+            context,
+            buffer,
+            length,
+            flags,
+            msg->msg_name,
+            msg->msg_namelen
+        );
+    }
+
+    // Sending the buffers separately would split a datagram into several, so
+    // datagrams that don't fit can't be sent
+    if (socket->type != SOCK_STREAM)
+    {
+        errno = EMSGSIZE;
+
+        return -1;
+    }
+
+    ssize_t sent = 0;
+
+    // The data won't fit into an intermediate buffer, so send the buffers
+    // separately
+    for (int i = 0; i < msg->msg_iovlen; i++)
+    {
+        if (msg->msg_iov[i].iov_len == 0)
+        {
+            continue;
+        }
+
+        ssize_t result = nl_socket_sendto(
+            context,
+            msg->msg_iov[i].iov_base,
+            msg->msg_iov[i].iov_len,
+            flags,
+            msg->msg_name,
+            msg->msg_namelen
+        );
+
+        // If nothing was sent yet, report the failure, and otherwise report
+        // what did get sent
+        if (result < 0)
+        {
+            return (sent > 0) ? sent : result;
+        }
+
+        sent += result;
+
+        // If this buffer only partially went out, the rest won't either
+        if ((size_t)result < msg->msg_iov[i].iov_len)
+        {
+            break;
+        }
+    }
+
+    return sent;
+}
 
+static ssize_t nl_socket_recvmsg(void *context, struct msghdr *msg, int flags)
+{
     if (msg == NULL)
     {
         errno = EINVAL;
@@ -321,213 +1815,749 @@ static ssize_t nl_socket_sendmsg(void *context, const struct msghdr *msg, int fl
         return -1;
     }
 
-    ssize_t length = 0;
+    msg->msg_flags = 0;
+
+    // If there's only a single buffer, there's nothing to scatter, so receive
+    // into it directly
+    if (msg->msg_iovlen == 1)
+    {
+        return nl_socket_recvfrom(
+            context,
+            msg->msg_iov[0].iov_base,
+            msg->msg_iov[0].iov_len,
+            flags,
+            msg->msg_name,
+            (msg->msg_name != NULL) ? &(msg->msg_namelen) : NULL
+        );
+    }
+
+    struct nl_socket *socket = context;
+
+    size_t length = 0;
 
-    // Try to reduce number of `sendto` calls by copying data if they fit into a
-    // single buffer
     for (int i = 0; i < msg->msg_iovlen; i++)
     {
         length += msg->msg_iov[i].iov_len;
     }
 
+    // Receive into a single buffer so a datagram arrives whole in a single
+    // `recvfrom` call
+    //
+    // Each call has its own buffer, so sockets don't have to wait on each
+    // other.
+    uint8_t buffer[CONFIG_NIMBELINK_SOCKETS_RECVMSG_BUFFER_SIZE];
+
     if (length <= sizeof(buffer))
     {
-        k_mutex_lock(&lock, K_FOREVER);
+        ssize_t result = nl_socket_recvfrom(
+            context,
+            buffer,
+            length,
+            flags,
+            msg->msg_name,
+            (msg->msg_name != NULL) ? &(msg->msg_namelen) : NULL
+        );
 
-        length = 0;
+        // Scatter whatever we got across the caller's buffers
+        size_t offset = 0;
 
-        for (int i = 0; i < msg->msg_iovlen; i++)
+        for (int i = 0; (result > 0) && (i < msg->msg_iovlen) && (offset < result); i++)
         {
-            memcpy(
-                buffer + length,
-                msg->msg_iov[i].iov_base,
-                msg->msg_iov[i].iov_len
-            );
+            size_t chunk = MIN(msg->msg_iov[i].iov_len, result - offset);
 
-            length += msg->msg_iov[i].iov_len;
+            memcpy(msg->msg_iov[i].iov_base, buffer + offset, chunk);
+
+            offset += chunk;
+        }
+
+        return result;
+    }
+
+    // Receiving into the buffers separately would split a datagram across
+    // several receives, so datagrams that might not fit can't be received
+    if (socket->type != SOCK_STREAM)
+    {
+        errno = EMSGSIZE;
+
+        return -1;
+    }
+
+    ssize_t received = 0;
+
+    // The data won't fit into an intermediate buffer, so receive into the
+    // buffers separately
+    //
+    // Only the first receive waits, and the rest just take whatever has
+    // already arrived. Peeking would keep returning the same data, so a peek
+    // only fills the first buffer.
+    for (int i = 0; i < msg->msg_iovlen; i++)
+    {
+        if (msg->msg_iov[i].iov_len == 0)
+        {
+            continue;
+        }
+
+        ssize_t result = nl_socket_recvfrom(
+            context,
+            msg->msg_iov[i].iov_base,
+            msg->msg_iov[i].iov_len,
+            (received == 0) ? flags : (flags | MSG_DONTWAIT),
+            (received == 0) ? msg->msg_name : NULL,
+            ((received == 0) && (msg->msg_name != NULL)) ? &(msg->msg_namelen) : NULL
+        );
+
+        // If nothing was received yet, report the failure, and otherwise
+        // report what did get received
+        if (result < 0)
+        {
+            return (received > 0) ? received : result;
+        }
+
+        received += result;
+
+        // If this buffer wasn't filled, there's nothing more waiting
+        if (((size_t)result < msg->msg_iov[i].iov_len) || ((flags & MSG_PEEK) != 0))
+        {
+            break;
+        }
+    }
+
+    return received;
+}
+
+/**
+ * \brief Gets the offloaded socket context for a file descriptor
+ *
+ * \param sock
+ *      The file descriptor
+ *
+ * \return NULL
+ *      Not an offloaded socket, errno set
+ * \return void *
+ *      The offloaded socket context
+ */
+static void *nl_socket_get_context(int sock)
+{
+    return z_get_fd_obj(
+        sock,
+        (const struct fd_op_vtable *)&nl_socket_op_vtable,
+        ENOTSUP
+    );
+}
+
+ssize_t nl_recvmsg(int sock, struct msghdr *msg, int flags)
+{
+    void *context = nl_socket_get_context(sock);
+
+    if (context == NULL)
+    {
+        return -1;
+    }
+
+    return nl_socket_recvmsg(context, msg, flags);
+}
+
+int nl_recvmmsg(int sock, struct nl_mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    void *context = nl_socket_get_context(sock);
+
+    if (context == NULL)
+    {
+        return -1;
+    }
+
+    if ((msgvec == NULL) && (vlen > 0))
+    {
+        errno = EINVAL;
+
+        return -1;
+    }
+
+    unsigned int count;
+
+    for (count = 0; count < vlen; count++)
+    {
+        // Only the first message is waited for, and the rest are just taken
+        // if they're already here
+        ssize_t result = nl_socket_recvmsg(
+            context,
+            &(msgvec[count].msg_hdr),
+            (count == 0) ? flags : (flags | MSG_DONTWAIT)
+        );
+
+        // If that failed, anything we've already received is still our
+        // result, and the failure -- if it's not just running out of messages
+        // -- will happen again on the next call
+        if (result < 0)
+        {
+            if (count == 0)
+            {
+                return -1;
+            }
+
+            break;
+        }
+
+        msgvec[count].msg_len = result;
+    }
+
+    return count;
+}
+
+int nl_sendmmsg(int sock, struct nl_mmsghdr *msgvec, unsigned int vlen, int flags)
+{
+    void *context = nl_socket_get_context(sock);
+
+    if (context == NULL)
+    {
+        return -1;
+    }
+
+    if ((msgvec == NULL) && (vlen > 0))
+    {
+        errno = EINVAL;
+
+        return -1;
+    }
+
+    unsigned int count;
+
+    for (count = 0; count < vlen; count++)
+    {
+        ssize_t result = nl_socket_sendmsg(context, &(msgvec[count].msg_hdr), flags);
+
+        // If that failed, anything we've already sent is still our result
+        if (result < 0)
+        {
+            if (count == 0)
+            {
+                return -1;
+            }
+
+            break;
+        }
+
+        msgvec[count].msg_len = result;
+    }
+
+    return count;
+}
+
+#define ADDRINFO_MAX_COUNT      3
+
+/**
+ * \brief A single allocation holding an entire getaddrinfo() result chain
+ *
+ *  The first addrinfo structure is the head of the chain we give to the
+ *  caller, which lets us get back to the whole block when they free it.
+ */
+struct nl_addrinfo_block
+{
+    // The caller's addrinfo structures
+    struct addrinfo infos[ADDRINFO_MAX_COUNT];
+
+    // The structures' addresses
+    struct sockaddr addrs[ADDRINFO_MAX_COUNT];
+
+    // The structures' canonical names
+    char canonnames[ADDRINFO_MAX_COUNT][NET_AI_CANONNAME_MAX_LENGTH + 1];
+};
+
+// Our getaddrinfo() result chains
+K_MEM_SLAB_DEFINE(
+    addrinfoSlab,
+    sizeof(struct nl_addrinfo_block),
+    CONFIG_NIMBELINK_SOCKETS_ADDRINFO_BLOCKS,
+    __alignof__(struct nl_addrinfo_block)
+);
+
+/**
+ * \brief Allocates a getaddrinfo() result chain
+ *
+ *  The block is zeroed and each addrinfo's address and canonical name point
+ *  at the block's own storage, but the structures are not linked together.
+ *
+ * \param none
+ *
+ * \return NULL
+ *      Failed to allocate a block
+ * \return struct nl_addrinfo_block *
+ *      The block
+ */
+static struct nl_addrinfo_block *nl_addrinfo_block_allocate(void)
+{
+    struct nl_addrinfo_block *block;
+
+    if (k_mem_slab_alloc(&addrinfoSlab, (void **)&block, K_NO_WAIT) != 0)
+    {
+        return NULL;
+    }
+
+    memset(block, 0, sizeof(*block));
+
+    for (uint32_t i = 0; i < ADDRINFO_MAX_COUNT; i++)
+    {
+        block->infos[i].ai_addr = &(block->addrs[i]);
+        block->infos[i].ai_canonname = block->canonnames[i];
+    }
+
+    return block;
+}
+
+static void nl_socket_freeaddrinfo(struct addrinfo *root)
+{
+    // If they didn't provide a valid pointer, ignore this
+    if (root == NULL)
+    {
+        return;
+    }
+
+    // The head of the chain is the start of its block, so everything goes
+    // back in one go
+    void *block = CONTAINER_OF(root, struct nl_addrinfo_block, infos[0]);
+
+    k_mem_slab_free(&addrinfoSlab, &block);
+}
+
+#if CONFIG_NIMBELINK_DNS_CACHE
+/**
+ * \brief A cached getaddrinfo() result
+ */
+struct nl_dns_cache_entry
+{
+    // Whether or not this entry is in use
+    bool used;
+
+    // When this entry expires, in milliseconds of uptime
+    int64_t expiry;
+
+    // The lookup's node, if any
+    bool hasNode;
+    char node[CONFIG_NIMBELINK_DNS_CACHE_NAME_LENGTH + 1];
+
+    // The lookup's service, if any
+    bool hasService;
+    char service[CONFIG_NIMBELINK_DNS_CACHE_NAME_LENGTH + 1];
+
+    // The lookup's hints, if any
+    bool hasHints;
+    int hintFlags;
+    int hintFamily;
+    int hintSocktype;
+    int hintProtocol;
+
+    // How many results there are
+    size_t count;
+
+    // The results
+    struct
+    {
+        int flags;
+        int family;
+        int socktype;
+        int protocol;
+        socklen_t addrlen;
+        struct sockaddr addr;
+        bool hasCanonname;
+        char canonname[NET_AI_CANONNAME_MAX_LENGTH + 1];
+    } infos[ADDRINFO_MAX_COUNT];
+};
+
+// Our cached lookups
+static struct nl_dns_cache_entry dnsCache[CONFIG_NIMBELINK_DNS_CACHE_ENTRIES];
+
+// Our cache's statistics
+static uint32_t dnsCacheHits = 0;
+static uint32_t dnsCacheMisses = 0;
+
+// A lock for our cache
+static K_MUTEX_DEFINE(dnsCacheLock);
+
+/**
+ * \brief Checks if a lookup key string can be stored in a cache entry
+ *
+ * \param *key
+ *      The string
+ *
+ * \return false
+ *      String too long to store
+ * \return true
+ *      String can be stored
+ */
+static bool nl_dns_cache_key_fits(const char *key)
+{
+    return (key == NULL) || (strlen(key) <= CONFIG_NIMBELINK_DNS_CACHE_NAME_LENGTH);
+}
+
+/**
+ * \brief Stores a lookup key string in a cache entry
+ *
+ *  The string must fit, see nl_dns_cache_key_fits().
+ *
+ * \param *has
+ *      Where to store whether or not there is a string
+ * \param *destination
+ *      Where to store the string
+ * \param *source
+ *      The string
+ *
+ * \return none
+ */
+static void nl_dns_cache_store_key(bool *has, char *destination, const char *source)
+{
+    *has = (source != NULL);
+
+    if (source != NULL)
+    {
+        memcpy(destination, source, strlen(source) + 1);
+    }
+}
+
+/**
+ * \brief Checks if a lookup key string matches a cache entry's
+ *
+ * \param has
+ *      Whether or not the entry has a string
+ * \param *entry
+ *      The entry's string
+ * \param *key
+ *      The lookup's string
+ *
+ * \return bool
+ *      Whether or not the strings match
+ */
+static inline bool nl_dns_cache_key_matches(bool has, const char *entry, const char *key)
+{
+    if (key == NULL)
+    {
+        return !has;
+    }
+
+    return has && (strcmp(entry, key) == 0);
+}
+
+/**
+ * \brief Finds a lookup's unexpired cache entry
+ *
+ *  The cache lock must be held.
+ *
+ * \param *node
+ *      The lookup's node
+ * \param *service
+ *      The lookup's service
+ * \param *hints
+ *      The lookup's hints
+ *
+ * \return NULL
+ *      Lookup not cached
+ * \return struct nl_dns_cache_entry *
+ *      The lookup's cache entry
+ */
+static struct nl_dns_cache_entry *nl_dns_cache_find(const char *node, const char *service, const struct addrinfo *hints)
+{
+    int64_t now = k_uptime_get();
+
+    for (size_t i = 0; i < CONFIG_NIMBELINK_DNS_CACHE_ENTRIES; i++)
+    {
+        struct nl_dns_cache_entry *entry = &(dnsCache[i]);
+
+        if (!entry->used)
+        {
+            continue;
+        }
+
+        // If this one is stale, get rid of it while we're here
+        if (entry->expiry <= now)
+        {
+            entry->used = false;
+            continue;
+        }
+
+        if (!nl_dns_cache_key_matches(entry->hasNode, entry->node, node) ||
+            !nl_dns_cache_key_matches(entry->hasService, entry->service, service))
+        {
+            continue;
+        }
+
+        if (entry->hasHints != (hints != NULL))
+        {
+            continue;
+        }
+
+        if ((hints != NULL) && (
+            (entry->hintFlags != hints->ai_flags) ||
+            (entry->hintFamily != hints->ai_family) ||
+            (entry->hintSocktype != hints->ai_socktype) ||
+            (entry->hintProtocol != hints->ai_protocol)
+        ))
+        {
+            continue;
         }
 
-        int result = nl_socket_sendto(
-            context,
-            buffer,
-            length,
-            flags,
-            msg->msg_name,
-            msg->msg_namelen
-        );
+        return entry;
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Tries to get a lookup's results from the cache
+ *
+ * \param *node
+ *      The lookup's node
+ * \param *service
+ *      The lookup's service
+ * \param *hints
+ *      The lookup's hints
+ * \param **res
+ *      Where to store the results
+ *
+ * \return -ENOENT
+ *      Lookup not cached
+ * \return DNS_EAI_MEMORY
+ *      Failed to allocate the results
+ * \return 0
+ *      Results found
+ */
+static int nl_dns_cache_lookup(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res)
+{
+    k_mutex_lock(&dnsCacheLock, K_FOREVER);
+
+    const struct nl_dns_cache_entry *entry = nl_dns_cache_find(node, service, hints);
+
+    if (entry == NULL)
+    {
+        dnsCacheMisses++;
 
-        k_mutex_unlock(&lock);
+        k_mutex_unlock(&dnsCacheLock);
 
-        return result;
+        return -ENOENT;
     }
 
-    length = 0;
+    dnsCacheHits++;
 
-    // The data won't fit into intermediate buffer, so send the buffers
-    // separately
-    for (int i = 0; i < msg->msg_iovlen; i++)
+    struct nl_addrinfo_block *block = nl_addrinfo_block_allocate();
+
+    if (block == NULL)
     {
-        if (msg->msg_iov[i].iov_len == 0)
+        k_mutex_unlock(&dnsCacheLock);
+
+        return DNS_EAI_MEMORY;
+    }
+
+    for (size_t i = 0; i < entry->count; i++)
+    {
+        struct addrinfo *info = &(block->infos[i]);
+
+        if (i > 0)
         {
-            continue;
+            block->infos[i - 1].ai_next = info;
         }
 
-        int result = nl_socket_sendto(
-            context,
-            msg->msg_iov[i].iov_base,
-            msg->msg_iov[i].iov_len,
-            flags,
-            msg->msg_name,
-            msg->msg_namelen
-        );
+        info->ai_flags      = entry->infos[i].flags;
+        info->ai_family     = entry->infos[i].family;
+        info->ai_socktype   = entry->infos[i].socktype;
+        info->ai_protocol   = entry->infos[i].protocol;
+        info->ai_addrlen    = entry->infos[i].addrlen;
 
-        if (result < 0)
+        memcpy(info->ai_addr, &(entry->infos[i].addr), sizeof(struct sockaddr));
+
+        if (entry->infos[i].hasCanonname)
         {
-            return result;
+            strcpy(info->ai_canonname, entry->infos[i].canonname);
+        }
+        else
+        {
+            info->ai_canonname = NULL;
         }
-
-        length += result;
     }
 
-    return length;
+    k_mutex_unlock(&dnsCacheLock);
+
+    *res = &(block->infos[0]);
+
+    return 0;
 }
 
-static void nl_socket_freeaddrinfo(struct addrinfo *root)
+/**
+ * \brief Stores a lookup's results in the cache
+ *
+ *  If the cache is full, the entry closest to expiring is replaced.
+ *
+ * \param *node
+ *      The lookup's node
+ * \param *service
+ *      The lookup's service
+ * \param *hints
+ *      The lookup's hints
+ * \param *res
+ *      The lookup's results
+ *
+ * \return none
+ */
+static void nl_dns_cache_store(const char *node, const char *service, const struct addrinfo *hints, const struct addrinfo *res)
 {
-    // If they didn't provide a valid pointer, ignore this
-    if (root == NULL)
+    // If the lookup can't be cached, don't give up an entry for it
+    if (!nl_dns_cache_key_fits(node) || !nl_dns_cache_key_fits(service))
     {
         return;
     }
 
-    while (true)
-    {
-        // Get the next info, if any
-        struct addrinfo *next = root->ai_next;
+    k_mutex_lock(&dnsCacheLock, K_FOREVER);
+
+    // If this is already cached -- say, someone else looked it up at the same
+    // time -- just refresh that, otherwise find a free or stale entry
+    struct nl_dns_cache_entry *entry = nl_dns_cache_find(node, service, hints);
 
-        // Free the current structure
-        if (root->ai_addr != NULL)
+    for (size_t i = 0; (entry == NULL) && (i < CONFIG_NIMBELINK_DNS_CACHE_ENTRIES); i++)
+    {
+        if (!dnsCache[i].used)
         {
-            k_free(root->ai_addr);
+            entry = &(dnsCache[i]);
         }
+    }
 
-        if (root->ai_canonname != NULL)
+    for (size_t i = 0; (entry == NULL) && (i < CONFIG_NIMBELINK_DNS_CACHE_ENTRIES); i++)
+    {
+        if ((i == 0) || (dnsCache[i].expiry < entry->expiry))
         {
-            k_free(root->ai_canonname);
+            entry = &(dnsCache[i]);
         }
+    }
 
-        k_free(root);
+    entry->used = false;
 
-        // If we're out of infos now, move on
-        if (next == NULL)
-        {
-            break;
-        }
+    nl_dns_cache_store_key(&(entry->hasNode), entry->node, node);
+    nl_dns_cache_store_key(&(entry->hasService), entry->service, service);
 
-        // Note the next info and free it when we come back around
-        root = next;
-    }
-}
+    entry->hasHints = (hints != NULL);
 
-static void free_nl_addrinfo(struct nl_addrinfo *root)
-{
-    // If they didn't provide a valid pointer, ignore this
-    if (root == NULL)
+    if (hints != NULL)
     {
-        return;
+        entry->hintFlags = hints->ai_flags;
+        entry->hintFamily = hints->ai_family;
+        entry->hintSocktype = hints->ai_socktype;
+        entry->hintProtocol = hints->ai_protocol;
     }
 
-    while (true)
+    entry->count = 0;
+
+    for (; (res != NULL) && (entry->count < ADDRINFO_MAX_COUNT); res = res->ai_next)
     {
-        // Get the next info, if any
-        struct nl_addrinfo *next = root->ai_next;
+        size_t i = entry->count;
 
-        // Free the current structure
-        if (root->ai_addr != NULL)
+        entry->infos[i].flags = res->ai_flags;
+        entry->infos[i].family = res->ai_family;
+        entry->infos[i].socktype = res->ai_socktype;
+        entry->infos[i].protocol = res->ai_protocol;
+        entry->infos[i].addrlen = res->ai_addrlen;
+
+        if (res->ai_addr != NULL)
         {
-            k_free(root->ai_addr);
+            memcpy(&(entry->infos[i].addr), res->ai_addr, sizeof(struct sockaddr));
         }
-
-        if (root->ai_canonname != NULL)
+        else
         {
-            k_free(root->ai_canonname);
+            memset(&(entry->infos[i].addr), 0, sizeof(struct sockaddr));
         }
 
-        k_free(root);
+        entry->infos[i].hasCanonname = (res->ai_canonname != NULL);
 
-        // If we're out of infos now, move on
-        if (next == NULL)
+        if (res->ai_canonname != NULL)
         {
-            break;
+            strncpy(entry->infos[i].canonname, res->ai_canonname, NET_AI_CANONNAME_MAX_LENGTH);
+
+            entry->infos[i].canonname[NET_AI_CANONNAME_MAX_LENGTH] = '\0';
         }
 
-        // Note the next info and free it when we come back around
-        root = next;
+        entry->count++;
     }
-}
 
-#define ADDRINFO_MAX_COUNT      3
+    entry->expiry = k_uptime_get() + ((int64_t)CONFIG_NIMBELINK_DNS_CACHE_TTL * MSEC_PER_SEC);
+    entry->used = true;
 
-static int nl_socket_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res)
+    k_mutex_unlock(&dnsCacheLock);
+}
+
+void nl_dns_cache_flush(void)
 {
-    // Make stack-based addrinfo structures that we guarantee to be compatible
-    // with our Secure firmware
-    struct nl_addrinfo *infos[ADDRINFO_MAX_COUNT] = {NULL, };
+    k_mutex_lock(&dnsCacheLock, K_FOREVER);
 
-    // Innocent until proven guilty
-    bool allAllocated = true;
+    for (size_t i = 0; i < CONFIG_NIMBELINK_DNS_CACHE_ENTRIES; i++)
+    {
+        dnsCache[i].used = false;
+    }
 
-    // We cannot read Secure RAM, so we must manually allocate and copy
-    // addrinfo structures as part of the Secure Service
-    //
-    // To keep the socket APIs proper, we will still require a pointer to a
-    // pointer, but we'll allocate the structure and provide that to the Secure
-    // Service API call, and then -- if successful -- store that in the
-    // provided double pointer.
-    //
-    // We'll also use calloc() instead of malloc() to make sure the various
-    // pointers are explicitly initialized to NULL.
-    //
-    // Finally, as mentioned above, the calling addrinfo struct might not
-    // actually be standard, so we'll need to allocate the addrinfo container
-    // for both theirs and ours, but everything allocated within that container
-    // can be allocated once and passed around.
-    for (uint32_t i = 0; i < ADDRINFO_MAX_COUNT; i++)
+    k_mutex_unlock(&dnsCacheLock);
+}
+
+void nl_dns_cache_get_stats(struct nl_dns_cache_stats *stats)
+{
+    if (stats == NULL)
     {
-        infos[i] = k_calloc(1, sizeof(struct nl_addrinfo));
+        return;
+    }
 
-        if (infos[i] == NULL)
-        {
-            allAllocated = false;
-            break;
-        }
+    k_mutex_lock(&dnsCacheLock, K_FOREVER);
 
-        infos[i]->ai_addr = k_calloc(1, sizeof(struct sockaddr));
-        infos[i]->ai_canonname = k_calloc(1, NET_AI_CANONNAME_MAX_LENGTH + 1);
+    int64_t now = k_uptime_get();
 
-        if ((infos[i]->ai_addr == NULL) || (infos[i]->ai_canonname == NULL))
+    stats->hits = dnsCacheHits;
+    stats->misses = dnsCacheMisses;
+    stats->entries = 0;
+
+    for (size_t i = 0; i < CONFIG_NIMBELINK_DNS_CACHE_ENTRIES; i++)
+    {
+        if (dnsCache[i].used && (dnsCache[i].expiry > now))
         {
-            allAllocated = false;
-            break;
+            stats->entries++;
         }
     }
 
-    // If any of those failed, abort
-    if (!allAllocated)
-    {
-        for (uint32_t i = 0; i < ADDRINFO_MAX_COUNT; i++)
-        {
-            if (infos[i] == NULL)
-            {
-                break;
-            }
+    k_mutex_unlock(&dnsCacheLock);
+}
+#endif
 
-            free_nl_addrinfo(infos[i]);
-        }
+static int nl_socket_getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res)
+{
+#if CONFIG_NIMBELINK_DNS_CACHE
+    // If we've looked this up recently, we're done
+    int cacheResult = nl_dns_cache_lookup(node, service, hints, res);
+
+    if (cacheResult != -ENOENT)
+    {
+        return cacheResult;
+    }
+#endif
 
+    // We cannot read Secure RAM, so the Secure Service must fill in addrinfo
+    // structures that we provide
+    //
+    // The addrinfo structure the caller uses might not be the one our Secure
+    // firmware expects, so we'll hand the Secure Service compatible addrinfo
+    // structures on our stack. The addresses and canonical names they point
+    // to, however, live in a single block from our slab, alongside the
+    // caller's addrinfo structures, which will point to the same storage.
+    struct nl_addrinfo_block *block = nl_addrinfo_block_allocate();
+
+    if (block == NULL)
+    {
         return DNS_EAI_MEMORY;
     }
 
+    struct nl_addrinfo _infos[ADDRINFO_MAX_COUNT];
+    struct nl_addrinfo *infos[ADDRINFO_MAX_COUNT];
+
+    for (uint32_t i = 0; i < ADDRINFO_MAX_COUNT; i++)
+    {
+        memset(&(_infos[i]), 0, sizeof(_infos[i]));
+
+        _infos[i].ai_addr = block->infos[i].ai_addr;
+        _infos[i].ai_canonname = block->infos[i].ai_canonname;
+
+        infos[i] = &(_infos[i]);
+    }
+
     // Make a compatible hints structure
     struct nl_addrinfo _nlHints;
     struct nl_addrinfo *nlHints = NULL;
@@ -549,6 +2579,10 @@ static int nl_socket_getaddrinfo(const char *node, const char *service, const st
         nlHints = &_nlHints;
     }
 
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+    uint32_t start = k_cycle_get_32();
+#endif
+
     // Make the offloaded API call
     int result = Net_GetAddrInfo(
         node,
@@ -558,54 +2592,38 @@ static int nl_socket_getaddrinfo(const char *node, const char *service, const st
         infos
     );
 
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+    // This doesn't report failures through errno, so don't let the record
+    // look at a stale one
+    nl_socket_stats_record(NULL, Net_Api_GetAddrInfo, (result == 0) ? 0 : -1, start);
+#endif
+
     *res = NULL;
 
-    // If that was successful and we've got structs to pass around
-    if ((result == 0) && (infos[0]->ai_addr != NULL))
+    // If that was successful and we've got structs to pass around, copy
+    // everything over to the caller's structures
+    //
+    // Our structures always point at the block's storage, so only an address
+    // length filled in by the Secure Service says the first one holds a
+    // result. The address and canonical name storage is shared, so only the
+    // scalar fields need copying.
+    if ((result == 0) && (infos[0]->ai_addrlen != 0))
     {
-        struct addrinfo **previous = NULL;
-
         for (uint32_t i = 0; i < ADDRINFO_MAX_COUNT; i++)
         {
-            // Allocate another structure for their copy of the addrinfo
-            *res = k_calloc(1, sizeof(struct addrinfo));
-
-            // If that failed, we'll free everything and call this a failure
-            if (*res == NULL)
-            {
-                result = DNS_EAI_MEMORY;
-                break;
-            }
+            struct addrinfo *info = &(block->infos[i]);
 
-            // If this isn't the first structure we've allocated, link the
-            // previous one to this new one
-            if (previous != NULL)
+            // Link the previous structure to this new one
+            if (i > 0)
             {
-                *previous = *res;
+                block->infos[i - 1].ai_next = info;
             }
 
-            // In case this isn't our last go-round, note the new addrinfo
-            // structure so we can link to the next one
-            previous = &((*res)->ai_next);
-
-            // We had to use a potentially-incompatible addrinfo structure than
-            // what's defined in the system, so copy everything over to the
-            // calling structure
-            (*res)->ai_flags        = infos[i]->ai_flags;
-            (*res)->ai_family       = infos[i]->ai_family;
-            (*res)->ai_socktype     = infos[i]->ai_socktype;
-            (*res)->ai_protocol     = infos[i]->ai_protocol;
-            (*res)->ai_addrlen      = infos[i]->ai_addrlen;
-            (*res)->ai_addr         = infos[i]->ai_addr;
-            (*res)->ai_canonname    = infos[i]->ai_canonname;
-
-            (*res)->ai_next         = NULL;
-
-            // The external structures now track the sub-structures -- ai_addr
-            // and ai_canonname -- so stop tracking those in our internal
-            // structs
-            infos[i]->ai_addr       = NULL;
-            infos[i]->ai_canonname  = NULL;
+            info->ai_flags          = infos[i]->ai_flags;
+            info->ai_family         = infos[i]->ai_family;
+            info->ai_socktype       = infos[i]->ai_socktype;
+            info->ai_protocol       = infos[i]->ai_protocol;
+            info->ai_addrlen        = infos[i]->ai_addrlen;
 
             // If this is the last one in the chain, move on
             if (infos[i]->ai_next == NULL)
@@ -613,57 +2631,69 @@ static int nl_socket_getaddrinfo(const char *node, const char *service, const st
                 break;
             }
         }
+
+        *res = &(block->infos[0]);
     }
 
-    // Free our internal structures
-    for (uint32_t i = 0; i < ADDRINFO_MAX_COUNT; i++)
+    // If we ended up not passing anything to the caller, give the block back
+    if (*res == NULL)
     {
-        // We might have a mix of linked and unlinked structs, so just do them
-        // all one by one
-        infos[i]->ai_next = NULL;
-
-        free_nl_addrinfo(infos[i]);
+        nl_socket_freeaddrinfo(&(block->infos[0]));
     }
-
-    // If we ended up not successfully passing everything to the caller, also
-    // free any external structures we allocated
-    if (result != 0)
+#if CONFIG_NIMBELINK_DNS_CACHE
+    // Else, remember this for next time
+    else if (*res != NULL)
     {
-        nl_socket_freeaddrinfo(*res);
+        nl_dns_cache_store(node, service, hints, *res);
     }
+#endif
 
     return result;
 }
 
-static int nl_socket_fcntl(int fd, int cmd, va_list args)
+static int nl_socket_fcntl(void *context, int cmd, va_list args)
 {
-    int flags = va_arg(args, int);
+    int fd = OBJ_TO_FD(context);
 
-    int result = Net_Fcntl(
-        fd,
-        cmd,
-        flags
-    );
+    int flags = va_arg(args, int);
 
-    if (result < 0)
-    {
-        Kernel_Errno();
-    }
+    struct Net_FcntlParameters parameters = {
+        .fd = fd,
+        .cmd = cmd,
+        .args = flags
+    };
 
-    return result;
+    return nl_socket_call(context, Net_Api_Fcntl, &parameters, sizeof(parameters));
 }
 
 static int nl_socket_ioctl(void *context, unsigned int request, va_list args)
 {
-    int fd = OBJ_TO_FD(context);
-
     switch (request)
     {
+    #if CONFIG_NIMBELINK_SOCKETS_POLL_PREPARE
+        case ZFD_IOCTL_POLL_PREPARE:
+        {
+            struct zsock_pollfd *pfd = va_arg(args, struct zsock_pollfd *);
+            struct k_poll_event **pev = va_arg(args, struct k_poll_event **);
+            struct k_poll_event *pevEnd = va_arg(args, struct k_poll_event *);
+
+            return nl_socket_poll_prepare(context, pfd, pev, pevEnd);
+        }
+
+        case ZFD_IOCTL_POLL_UPDATE:
+        {
+            struct zsock_pollfd *pfd = va_arg(args, struct zsock_pollfd *);
+            struct k_poll_event **pev = va_arg(args, struct k_poll_event **);
+
+            return nl_socket_poll_update(context, pfd, pev);
+        }
+    #else
         case ZFD_IOCTL_POLL_PREPARE:
             return -EXDEV;
 
         case ZFD_IOCTL_POLL_UPDATE:
             return -EOPNOTSUPP;
+    #endif
 
         case ZFD_IOCTL_POLL_OFFLOAD:
         {
@@ -676,7 +2706,7 @@ static int nl_socket_ioctl(void *context, unsigned int request, va_list args)
 
         // In Zephyr, fcntl() is apparently just an alias of ioctl()
         default:
-            return nl_socket_fcntl(fd, request, args);
+            return nl_socket_fcntl(context, request, args);
     }
 }
 
@@ -732,7 +2762,19 @@ static int nl_socket_create(int family, int type, int proto)
         return -1;
     }
 
-    z_finalize_fd(fd, FD_TO_OBJ(sd), (const struct fd_op_vtable *)&nl_socket_op_vtable);
+    struct nl_socket *socket = nl_socket_allocate(fd, sd, type);
+
+    if (socket == NULL)
+    {
+        nl_socket_close_sd(sd);
+        z_free_fd(fd);
+
+        errno = ENFILE;
+
+        return -1;
+    }
+
+    z_finalize_fd(fd, socket, (const struct fd_op_vtable *)&nl_socket_op_vtable);
 
     return fd;
 }
@@ -744,10 +2786,235 @@ NET_SOCKET_REGISTER(
     nl_socket_create
 );
 
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+int nl_socket_get_api_stats(uint16_t api, struct nl_socket_stats *stats)
+{
+    if ((api >= NET_API_COUNT) || (stats == NULL))
+    {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&statsLock);
+
+    *stats = apiStats[api];
+
+    k_spin_unlock(&statsLock, key);
+
+    return 0;
+}
+
+int nl_socket_get_fd_stats(int fd, struct nl_socket_stats *stats)
+{
+    if (stats == NULL)
+    {
+        return -EINVAL;
+    }
+
+    if ((fd < 0) || (fd >= CONFIG_POSIX_MAX_FDS))
+    {
+        return -EBADF;
+    }
+
+    int result = -EBADF;
+
+    k_mutex_lock(&socketsLock, K_FOREVER);
+
+    if (fdSockets[fd] != NULL)
+    {
+        k_spinlock_key_t key = k_spin_lock(&statsLock);
+
+        *stats = fdSockets[fd]->stats;
+
+        k_spin_unlock(&statsLock, key);
+
+        result = 0;
+    }
+
+    k_mutex_unlock(&socketsLock);
+
+    return result;
+}
+
+void nl_socket_reset_stats(void)
+{
+    k_mutex_lock(&socketsLock, K_FOREVER);
+
+    k_spinlock_key_t key = k_spin_lock(&statsLock);
+
+    for (size_t i = 0; i < NET_API_COUNT; i++)
+    {
+        nl_socket_stats_clear(&(apiStats[i]));
+    }
+
+    for (size_t i = 0; i < (sizeof(sockets)/sizeof(sockets[0])); i++)
+    {
+        if (sockets[i].used)
+        {
+            nl_socket_stats_clear(&(sockets[i].stats));
+        }
+    }
+
+    k_spin_unlock(&statsLock, key);
+
+    k_mutex_unlock(&socketsLock);
+}
+
+#if CONFIG_NIMBELINK_SOCKETS_STATS_SHELL
+// The networking APIs' names
+static const char * const apiNames[NET_API_COUNT] = {
+    [Net_Api_Socket]                = "socket",
+    [Net_Api_Close]                 = "close",
+    [Net_Api_Accept]                = "accept",
+    [Net_Api_Bind]                  = "bind",
+    [Net_Api_Listen]                = "listen",
+    [Net_Api_Connect]               = "connect",
+    [Net_Api_Poll]                  = "poll",
+    [Net_Api_SetSockOpt]            = "setsockopt",
+    [Net_Api_GetSockOpt]            = "getsockopt",
+    [Net_Api_Recv]                  = "recv",
+    [Net_Api_RecvFrom]              = "recvfrom",
+    [Net_Api_Send]                  = "send",
+    [Net_Api_SendTo]                = "sendto",
+    [Net_Api_GetAddrInfo]           = "getaddrinfo",
+    [Net_Api_FreeAddrInfo]          = "freeaddrinfo",
+    [Net_Api_Fcntl]                 = "fcntl",
+};
+
+/**
+ * \brief Prints statistics
+ *
+ *  Each set of statistics is printed on a single line of key=value pairs, so
+ *  they're easy to pick apart with a script.
+ *
+ * \param *shell
+ *      The shell to print to
+ * \param *key
+ *      What the statistics are for
+ * \param *stats
+ *      The statistics
+ *
+ * \return none
+ */
+static void nl_socket_stats_print(const struct shell *shell, const char *key, const struct nl_socket_stats *stats)
+{
+    char histogram[LATENCY_HISTOGRAM_STRING_SIZE(NL_SOCKET_STATS_BUCKET_COUNT)];
+
+    shell_print(
+        shell,
+        "%s calls=%u errors=%u eagain=%u bytes=%llu min_us=%u avg_us=%u max_us=%u hist=%s",
+        key,
+        stats->calls,
+        stats->errors,
+        stats->eagain,
+        (unsigned long long)stats->bytes,
+        (stats->calls > 0) ? stats->min_latency : 0,
+        (stats->calls > 0) ? (uint32_t)(stats->total_latency / stats->calls) : 0,
+        stats->max_latency,
+        FormatLatencyHistogram(histogram, sizeof(histogram), stats->histogram, NL_SOCKET_STATS_BUCKET_COUNT)
+    );
+}
+
+static int nl_socket_shell_api(const struct shell *shell, size_t argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    for (uint16_t api = 0; api < NET_API_COUNT; api++)
+    {
+        struct nl_socket_stats stats;
+
+        nl_socket_get_api_stats(api, &stats);
+
+        if (stats.calls == 0)
+        {
+            continue;
+        }
+
+        char key[32];
+
+        snprintk(key, sizeof(key), "api=%s", apiNames[api]);
+
+        nl_socket_stats_print(shell, key, &stats);
+    }
+
+    return 0;
+}
+
+static int nl_socket_shell_fd(const struct shell *shell, size_t argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    for (int fd = 0; fd < CONFIG_POSIX_MAX_FDS; fd++)
+    {
+        struct nl_socket_stats stats;
+
+        if (nl_socket_get_fd_stats(fd, &stats) != 0)
+        {
+            continue;
+        }
+
+        char key[16];
+
+        snprintk(key, sizeof(key), "fd=%d", fd);
+
+        nl_socket_stats_print(shell, key, &stats);
+    }
+
+    return 0;
+}
+
+static int nl_socket_shell_reset(const struct shell *shell, size_t argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    nl_socket_reset_stats();
+
+    shell_print(shell, "Statistics reset");
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(nl_socket_shell_stats,
+    SHELL_CMD(api, NULL, "Show statistics for each networking API", nl_socket_shell_api),
+    SHELL_CMD(fd, NULL, "Show statistics for each open socket", nl_socket_shell_fd),
+    SHELL_CMD(reset, NULL, "Reset all statistics", nl_socket_shell_reset),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_STATIC_SUBCMD_SET_CREATE(nl_socket_shell,
+    SHELL_CMD(stats, &nl_socket_shell_stats, "Offloaded socket statistics", NULL),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(nl_sockets, &nl_socket_shell, "NimbeLink offloaded sockets", NULL);
+#endif
+#endif
+
 static int nl_socket_init(const struct device *arg)
 {
     (void)arg;
 
+#if CONFIG_NIMBELINK_SOCKETS_STATS
+    nl_socket_reset_stats();
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_READINESS_EVENTS
+    Net_SubscribeReadiness(nl_socket_readiness);
+#endif
+
+#if CONFIG_NIMBELINK_SOCKETS_TX_COALESCE
+    k_work_q_start(
+        &txQueue,
+        txStack,
+        K_THREAD_STACK_SIZEOF(txStack),
+        CONFIG_NIMBELINK_SOCKETS_TX_COALESCE_PRIORITY
+    );
+
+    k_thread_name_set(&(txQueue.thread), "nl_socket_tx");
+#endif
+
     return 0;
 }
 
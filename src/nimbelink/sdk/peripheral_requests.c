@@ -87,15 +87,37 @@ static int RequestPeripherals(const struct device *device)
     #   endif
     };
 
+    static struct Kernel_PeripheralAccessParameters parameters[sizeof(Peripherals)/sizeof(Peripherals[0])];
+    static struct SecureServiceBatchEntry entries[sizeof(Peripherals)/sizeof(Peripherals[0])];
+
     (void)device;
 
+    // Request all of the peripherals in one batch, rather than waiting for each
+    // request in turn
     for (size_t i = 0; i < (sizeof(Peripherals)/sizeof(Peripherals[0])); i++)
     {
-        int32_t result = Kernel_PeripheralAccess((const void *)(Peripherals[i]));
+        parameters[i].peripheral = (const void *)(Peripherals[i]);
+
+        entries[i] = (struct SecureServiceBatchEntry) {
+            .service = SecureService_Kernel,
+            .api = Kernel_Api_PeripheralAccess,
+            .parameters = &(parameters[i]),
+            .size = sizeof(parameters[i])
+        };
+    }
+
+    int32_t result = CallSecureServiceBatch(entries, (sizeof(entries)/sizeof(entries[0])));
+
+    if (result != 0)
+    {
+        return result;
+    }
 
-        if (result != 0)
+    for (size_t i = 0; i < (sizeof(entries)/sizeof(entries[0])); i++)
+    {
+        if (entries[i].result != 0)
         {
-            return result;
+            return entries[i].result;
         }
     }
 
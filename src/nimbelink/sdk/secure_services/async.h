@@ -13,6 +13,11 @@
  */
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/atomic.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -24,7 +29,44 @@ extern "C"
 enum Async_Event
 {
     // A new AT URC
-    Async_Event_AtUrc       = 0,
+    Async_Event_AtUrc           = 0,
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+    // A socket's readiness changed
+    //
+    // No stack firmware ABI defines this yet, so it's only sent by the
+    // emulator.
+    Async_Event_NetReadiness    = 1,
+#endif
+
+    // A PDN connection's state changed
+    Async_Event_PdnState        = 2,
+
+    // A FOTA update made progress
+    Async_Event_FotaProgress    = 3,
+
+    // The modem went to sleep or woke up
+    Async_Event_ModemSleep      = 4,
+
+    // The number of events
+    Async_Event_Count,
+};
+
+/**
+ * \brief The ways asynchronous messages can be retrieved
+ */
+enum Async_Api
+{
+    // Get a single message as an Async_Parameters
+    Async_Api_GetMessage    = 0,
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+    // Get as many messages as fit in an Async_BatchParameters
+    //
+    // No stack firmware ABI defines this yet, so it's only available with the
+    // emulator.
+    Async_Api_GetMessages   = 1,
+#endif
 };
 
 struct Async_Parameters
@@ -36,6 +78,255 @@ struct Async_Parameters
     uint8_t buffer[1024];
 };
 
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+/**
+ * \brief A message in an Async_BatchParameters
+ *
+ *  Each message is followed by the next one, starting at the next 4-byte
+ *  boundary after its data.
+ */
+struct Async_BatchMessage
+{
+    // The event that occurred
+    uint32_t event;
+
+    // The length of the message's data
+    uint32_t length;
+
+    // The message's data
+    uint8_t data[];
+};
+
+/**
+ * \brief Gets how much room a batched message takes up
+ *
+ * \param length
+ *      The length of the message's data
+ */
+#define ASYNC_BATCH_MESSAGE_SIZE(length)    \
+    (sizeof(struct Async_BatchMessage) + (((length) + 3) & ~3))
+
+/**
+ * \brief Parameters for getting a batch of asynchronous messages
+ *
+ *  Only Secure firmware that supports Async_Api_GetMessages can fill these in.
+ */
+struct Async_BatchParameters
+{
+    // The most messages to get, and then how many were gotten
+    uint32_t count;
+
+    // The messages
+    uint8_t messages[];
+};
+#endif
+
+/**
+ * \brief The states a PDN connection can be in
+ */
+enum Async_PdnState
+{
+    // The PDN connection was deactivated
+    Async_PdnState_Deactivated  = 0,
+
+    // The PDN connection was activated
+    Async_PdnState_Activated    = 1,
+
+    // The PDN connection was suspended
+    Async_PdnState_Suspended    = 2,
+
+    // The PDN connection was resumed
+    Async_PdnState_Resumed      = 3,
+};
+
+/**
+ * \brief An Async_Event_PdnState message
+ */
+struct Async_PdnStateEvent
+{
+    // The PDN context ID
+    uint32_t cid;
+
+    // The PDN connection's new state
+    uint32_t state;
+};
+
+/**
+ * \brief The states a FOTA update can be in
+ */
+enum Async_FotaState
+{
+    // The update is downloading
+    Async_FotaState_Downloading = 0,
+
+    // The update finished downloading and is pending a reboot
+    Async_FotaState_Finished    = 1,
+
+    // The update failed
+    Async_FotaState_Error       = 2,
+};
+
+/**
+ * \brief An Async_Event_FotaProgress message
+ */
+struct Async_FotaProgressEvent
+{
+    // The update's state
+    uint32_t state;
+
+    // How many bytes have been downloaded
+    uint32_t offset;
+
+    // If the update failed, why
+    int32_t error;
+};
+
+/**
+ * \brief The sleep states the modem can be in
+ */
+enum Async_ModemSleepState
+{
+    // The modem woke up
+    Async_ModemSleepState_Awake     = 0,
+
+    // The modem went to sleep
+    Async_ModemSleepState_Sleeping  = 1,
+};
+
+/**
+ * \brief An Async_Event_ModemSleep message
+ */
+struct Async_ModemSleepEvent
+{
+    // The modem's new sleep state
+    uint32_t state;
+
+    // If going to sleep, how long the modem expects to sleep, in milliseconds,
+    // or 0 if unknown
+    uint32_t duration;
+};
+
+typedef void (*Async_Handler)(uint32_t event, const void *data, size_t size, void *context);
+
+/**
+ * \brief Registers a handler for an asynchronous event
+ *
+ *  Each event has a single handler, which is invoked from the asynchronous
+ *  message thread with the message's data. The size given to the handler is
+ *  the length of the message when the Secure firmware reports it, and the
+ *  size of the buffer it was delivered in otherwise. The data is only valid
+ *  until the handler returns, and the handler should return quickly, as no
+ *  other messages are drained while it runs.
+ *
+ *  URCs are handled by the SDK itself, and are available through
+ *  At_AddUrcSubscription(). Net_SubscribeReadiness() registers the socket
+ *  readiness handler.
+ *
+ *  The other events are only sent by Secure firmware that supports them, and
+ *  their handlers are otherwise never invoked.
+ *
+ * \param event
+ *      The event to handle
+ * \param handler
+ *      The handler to invoke
+ * \param *context
+ *      A context to pass to the handler
+ *
+ * \return -EINVAL
+ *      Invalid event or handler
+ * \return -EALREADY
+ *      The event already has a handler
+ * \return 0
+ *      Handler registered
+ */
+int32_t Async_RegisterHandler(uint32_t event, Async_Handler handler, void *context);
+
+/**
+ * \brief Unregisters an asynchronous event's handler
+ *
+ * \param event
+ *      The event
+ * \param handler
+ *      The handler that was registered
+ *
+ * \return -EINVAL
+ *      Invalid event
+ * \return -ENOENT
+ *      The handler isn't registered for the event
+ * \return 0
+ *      Handler unregistered
+ */
+int32_t Async_UnregisterHandler(uint32_t event, Async_Handler handler);
+
+/**
+ * \brief A reference-counted copy of an asynchronous message
+ *
+ *  Asynchronous messages handed to subscribers -- such as the URCs given to
+ *  URC subscription handlers -- live in one of these, allocated from a shared
+ *  pool with just enough room for the message. A subscriber can hold on to
+ *  the message after its handler returns by taking a reference with
+ *  Async_BufferRef(), and must then release it with Async_BufferUnref() once
+ *  it's done.
+ */
+struct Async_Buffer
+{
+    // The number of references to the buffer
+    atomic_t references;
+
+    // The event that occurred
+    uint32_t event;
+
+    // The length of the message's data
+    uint32_t length;
+
+    // The message's data
+    uint8_t data[];
+};
+
+/**
+ * \brief Gets the buffer holding data lent to a subscriber
+ *
+ *  This is only valid for data handed to a subscriber from an asynchronous
+ *  message buffer, such as a URC given to a URC subscription handler, and
+ *  only while the subscriber's handler is running or it holds a reference.
+ *
+ * \param *data
+ *      The data
+ *
+ * \return struct Async_Buffer *
+ *      The buffer holding the data
+ */
+static inline struct Async_Buffer *Async_GetBuffer(const void *data)
+{
+    return (struct Async_Buffer *)((uintptr_t)data - offsetof(struct Async_Buffer, data));
+}
+
+/**
+ * \brief Takes a reference to an asynchronous message buffer
+ *
+ *  This can be called from an interrupt.
+ *
+ * \param *buffer
+ *      The buffer
+ *
+ * \return struct Async_Buffer *
+ *      The buffer
+ */
+struct Async_Buffer *Async_BufferRef(struct Async_Buffer *buffer);
+
+/**
+ * \brief Releases a reference to an asynchronous message buffer
+ *
+ *  Once the last reference is released, the buffer goes back to the pool. This
+ *  can be called from an interrupt.
+ *
+ * \param *buffer
+ *      The buffer
+ *
+ * \return none
+ */
+void Async_BufferUnref(struct Async_Buffer *buffer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -48,11 +339,194 @@ namespace NimbeLink::Sdk::SecureServices::Async
         enum _E
         {
             AtUrc           = Async_Event_AtUrc,
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+            NetReadiness    = Async_Event_NetReadiness,
+#endif
+            PdnState        = Async_Event_PdnState,
+            FotaProgress    = Async_Event_FotaProgress,
+            ModemSleep      = Async_Event_ModemSleep,
         };
     };
 
     using Event = _Event::_E;
 
+    struct _Api
+    {
+        enum _E
+        {
+            GetMessage  = Async_Api_GetMessage,
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+            GetMessages = Async_Api_GetMessages,
+#endif
+        };
+    };
+
+    using Api = _Api::_E;
+
     using Parameters = Async_Parameters;
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+    using BatchMessage = Async_BatchMessage;
+
+    using BatchParameters = Async_BatchParameters;
+#endif
+
+    struct _PdnState
+    {
+        enum _E
+        {
+            Deactivated = Async_PdnState_Deactivated,
+            Activated   = Async_PdnState_Activated,
+            Suspended   = Async_PdnState_Suspended,
+            Resumed     = Async_PdnState_Resumed,
+        };
+    };
+
+    using PdnState = _PdnState::_E;
+
+    using PdnStateEvent = Async_PdnStateEvent;
+
+    struct _FotaState
+    {
+        enum _E
+        {
+            Downloading = Async_FotaState_Downloading,
+            Finished    = Async_FotaState_Finished,
+            Error       = Async_FotaState_Error,
+        };
+    };
+
+    using FotaState = _FotaState::_E;
+
+    using FotaProgressEvent = Async_FotaProgressEvent;
+
+    struct _ModemSleepState
+    {
+        enum _E
+        {
+            Awake       = Async_ModemSleepState_Awake,
+            Sleeping    = Async_ModemSleepState_Sleeping,
+        };
+    };
+
+    using ModemSleepState = _ModemSleepState::_E;
+
+    using ModemSleepEvent = Async_ModemSleepEvent;
+
+    using Handler = Async_Handler;
+
+    /**
+     * \brief The message each event carries
+     */
+    template<Event event>
+    struct EventData;
+
+    template<>
+    struct EventData<Event::PdnState>
+    {
+        using Type = PdnStateEvent;
+    };
+
+    template<>
+    struct EventData<Event::FotaProgress>
+    {
+        using Type = FotaProgressEvent;
+    };
+
+    template<>
+    struct EventData<Event::ModemSleep>
+    {
+        using Type = ModemSleepEvent;
+    };
+
+    template<Event event>
+    using TypedHandler = void (*)(const typename EventData<event>::Type &data);
+
+    static inline int32_t RegisterHandler(Event event, Handler handler, void *context = nullptr)
+    {
+        return Async_RegisterHandler(event, handler, context);
+    }
+
+    static inline int32_t UnregisterHandler(Event event, Handler handler)
+    {
+        return Async_UnregisterHandler(event, handler);
+    }
+
+    /**
+     * \brief The typed handler registered for an event
+     */
+    template<Event event>
+    struct TypedHandlerSlot
+    {
+        static inline TypedHandler<event> handler = nullptr;
+    };
+
+    /**
+     * \brief Invokes a typed handler with its event's message
+     *
+     *  Messages too short for the event's data are dropped.
+     */
+    template<Event event>
+    static void InvokeTypedHandler(uint32_t, const void *data, size_t size, void *)
+    {
+        using Type = typename EventData<event>::Type;
+
+        TypedHandler<event> handler = TypedHandlerSlot<event>::handler;
+
+        if ((handler != nullptr) && (size >= sizeof(Type)))
+        {
+            handler(*static_cast<const Type *>(data));
+        }
+    }
+
+    template<Event event>
+    static inline int32_t RegisterHandler(TypedHandler<event> handler)
+    {
+        if (handler == nullptr)
+        {
+            return Async_RegisterHandler(event, nullptr, nullptr);
+        }
+
+        int32_t result = Async_RegisterHandler(event, InvokeTypedHandler<event>, nullptr);
+
+        // Only the registration that won the event's slot gets to fill in the
+        // typed handler
+        if (result == 0)
+        {
+            TypedHandlerSlot<event>::handler = handler;
+        }
+
+        return result;
+    }
+
+    template<Event event>
+    static inline int32_t UnregisterHandler(void)
+    {
+        int32_t result = Async_UnregisterHandler(event, InvokeTypedHandler<event>);
+
+        if (result == 0)
+        {
+            TypedHandlerSlot<event>::handler = nullptr;
+        }
+
+        return result;
+    }
+
+    using Buffer = Async_Buffer;
+
+    static inline Buffer *GetBuffer(const void *data)
+    {
+        return Async_GetBuffer(data);
+    }
+
+    static inline Buffer *BufferRef(Buffer *buffer)
+    {
+        return Async_BufferRef(buffer);
+    }
+
+    static inline void BufferUnref(Buffer *buffer)
+    {
+        Async_BufferUnref(buffer);
+    }
 }
 #endif
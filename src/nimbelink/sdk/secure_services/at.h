@@ -13,6 +13,7 @@
  */
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -175,6 +176,10 @@ struct At_SubscribeUrcsParameters
 /**
  * \brief Subscribes to new URC notifications
  *
+ *  Only one callback can be subscribed this way, and it gets every URC. Use
+ *  At_AddUrcSubscription() to have any number of subscribers that only get the
+ *  URCs they're interested in.
+ *
  * \param callback
  *      The callback to invoke when a new URC is ready
  *
@@ -190,6 +195,126 @@ static inline int32_t At_SubscribeUrcs(At_UrcCallback callback)
     return CallSecureService(SecureService_At, At_Api_SubscribeUrcs, &parameters, sizeof(parameters));
 }
 
+typedef void (*At_UrcHandler)(const char *urc, void *context);
+
+/**
+ * \brief A subscription to URCs starting with a prefix
+ *
+ *  The subscription is owned by the subscriber, and must remain valid until
+ *  it's removed. Only the prefix, handler, and context should be set by the
+ *  subscriber, and the rest should be zeroed before the subscription is first
+ *  added.
+ */
+struct At_UrcSubscription
+{
+    // The prefix URCs must start with, or "" for all URCs
+    const char *prefix;
+
+    // The handler to invoke with matching URCs
+    At_UrcHandler handler;
+
+    // A context to pass to the handler
+    void *context;
+
+    // The next subscription with the same prefix
+    struct At_UrcSubscription *next;
+
+    // The prefix trie node the subscription is attached to
+    uint16_t node;
+
+    // Whether or not the subscription is added
+    bool active;
+
+    // The last dispatch the subscription was handled in
+    uint32_t generation;
+};
+
+/**
+ * \brief Adds a URC subscription
+ *
+ *  URCs are matched against every subscription's prefix in a single pass over
+ *  the URC, and each matching subscription's handler is invoked from the URC
+ *  work queue, or from the asynchronous message thread if
+ *  CONFIG_SECURE_SERVICES_URC_QUEUE is disabled. Subscriptions with the same
+ *  prefix are invoked in the order they were added, and shorter prefixes are
+ *  invoked first.
+ *
+ *  The URC is lent to the handler in an asynchronous message buffer, which is
+ *  only valid until the handler returns. A handler that needs the URC for
+ *  longer can take a reference to it with Async_BufferRef(Async_GetBuffer(urc))
+ *  rather than copying it.
+ *
+ *  Handlers can add and remove subscriptions, including their own. A
+ *  subscription added by a handler won't be handed the URC being dispatched.
+ *  This cannot be called from an interrupt.
+ *
+ * \param *subscription
+ *      The subscription to add
+ *
+ * \return -EINVAL
+ *      Invalid subscription
+ * \return -EALREADY
+ *      Subscription already added
+ * \return -ENOMEM
+ *      Not enough prefix trie nodes left for the prefix
+ * \return 0
+ *      Subscription added
+ */
+int32_t At_AddUrcSubscription(struct At_UrcSubscription *subscription);
+
+/**
+ * \brief Removes a URC subscription
+ *
+ *  If the subscription's handler is running in another thread, this waits for
+ *  it to finish, so the subscription can be reused as soon as this returns.
+ *  This cannot be called from an interrupt.
+ *
+ * \param *subscription
+ *      The subscription to remove
+ *
+ * \return -EINVAL
+ *      Invalid subscription
+ * \return -ENOENT
+ *      Subscription not added
+ * \return 0
+ *      Subscription removed
+ */
+int32_t At_RemoveUrcSubscription(struct At_UrcSubscription *subscription);
+
+/**
+ * \brief Statistics for the queue of URCs waiting on their subscribers
+ *
+ *  Sizes are in URCs.
+ */
+struct At_UrcQueueStats
+{
+    // How many URCs were dropped because the queue or the asynchronous message
+    // buffer pool was full
+    uint32_t drops;
+
+    // How many URCs are currently queued
+    uint32_t used;
+
+    // The most URCs the queue has held at once
+    uint32_t highWater;
+
+    // How many URCs the queue can hold
+    uint32_t capacity;
+};
+
+/**
+ * \brief Gets the URC queue's statistics
+ *
+ *  If CONFIG_SECURE_SERVICES_URC_QUEUE is disabled, only the drops are
+ *  counted.
+ *
+ * \param *stats
+ *      Where to put the statistics
+ *
+ * \return none
+ */
+void At_GetUrcQueueStats(struct At_UrcQueueStats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -253,5 +378,29 @@ namespace NimbeLink::Sdk::SecureServices::At
     {
         return At_SubscribeUrcs(callback);
     }
+
+    using UrcHandler = At_UrcHandler;
+    using UrcSubscription = At_UrcSubscription;
+
+    static inline int32_t AddUrcSubscription(UrcSubscription &subscription)
+    {
+        return At_AddUrcSubscription(&subscription);
+    }
+
+    static inline int32_t RemoveUrcSubscription(UrcSubscription &subscription)
+    {
+        return At_RemoveUrcSubscription(&subscription);
+    }
+
+    using UrcQueueStats = At_UrcQueueStats;
+
+    static inline UrcQueueStats GetUrcQueueStats(void)
+    {
+        UrcQueueStats stats;
+
+        At_GetUrcQueueStats(&stats);
+
+        return stats;
+    }
 }
 #endif
@@ -14,8 +14,10 @@
  */
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
-#include <hal/nrf_egu.h>
+#include <kernel.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -66,6 +68,235 @@ extern int32_t __GetSecureServiceResponse(uint32_t request, void *parameters, ui
 
 extern int32_t CallSecureService(uint8_t service, uint16_t api, void *parameters, uint32_t size);
 
+/**
+ * \brief Calls a secure service, giving up if it takes too long
+ *
+ *  If the call times out after its request was queued, the channel it used
+ *  stays reserved until the Secure firmware's late response is consumed, and
+ *  the response itself is discarded. Any buffers referenced by the parameters
+ *  might still be written by the Secure firmware until then.
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ * \param *parameters
+ *      Parameters for the call
+ * \param size
+ *      The size of the parameters
+ * \param timeout
+ *      How long to wait for the call, including waiting for a free channel
+ *
+ * \return -EINVAL
+ *      The parameters are larger than CONFIG_SECURE_SERVICES_DRAIN_BUFFER_SIZE
+ * \return -ETIMEDOUT
+ *      The call didn't complete in time
+ * \return int32_t
+ *      The result of the call
+ */
+extern int32_t CallSecureServiceTimeout(uint8_t service, uint16_t api, void *parameters, uint32_t size, k_timeout_t timeout);
+
+/**
+ * \brief A single request in a batch of secure service calls
+ */
+struct SecureServiceBatchEntry
+{
+    // The secure service
+    uint8_t service;
+
+    // The service's API
+    uint16_t api;
+
+    // Parameters for the call
+    void *parameters;
+
+    // The size of the parameters
+    uint32_t size;
+
+    // The result of the call
+    int32_t result;
+};
+
+/**
+ * \brief Calls a batch of secure services
+ *
+ *  The requests are spread across all free channels and are not necessarily
+ *  serviced in order, so they should not depend on one another.
+ *
+ * \param *entries
+ *      The requests to make, whose results will be filled in
+ * \param count
+ *      The number of requests
+ *
+ * \return -EINVAL
+ *      Invalid entries
+ * \return 0
+ *      Batch handled, check each entry's result
+ */
+extern int32_t CallSecureServiceBatch(struct SecureServiceBatchEntry *entries, size_t count);
+
+/**
+ * \brief A callback for a completed asynchronous secure service call
+ *
+ *  The callback is invoked from the secure service completion work queue,
+ *  which also frees the channels of completed asynchronous calls. Blocking
+ *  secure service calls made from the callback never wait for a free channel.
+ *
+ * \param result
+ *      The result of the call
+ * \param *context
+ *      The context provided when the call was queued
+ *
+ * \return none
+ */
+typedef void (*SecureServiceCallback)(int32_t result, void *context);
+
+extern int32_t CallSecureServiceAsync(uint8_t service, uint16_t api, void *parameters, uint32_t size, SecureServiceCallback callback, void *context);
+
+/**
+ * \brief The phases of a secure service call that latency is measured for
+ */
+enum SecureServiceLatency
+{
+    // Waiting for a free channel
+    SecureServiceLatency_Reserve    = 0,
+
+    // Queueing the request with the Secure firmware
+    SecureServiceLatency_Put        = 1,
+
+    // Waiting for the Secure firmware to signal the response
+    SecureServiceLatency_Secure     = 2,
+
+    // Waking up after the response was signalled
+    SecureServiceLatency_Wake       = 3,
+
+    // Copying the response from the Secure firmware
+    SecureServiceLatency_Get        = 4,
+
+    SecureServiceLatency_Count
+};
+
+/**
+ * \brief How many buckets are in secure service latency histograms
+ */
+#define SECURE_SERVICE_LATENCY_BUCKET_COUNT     8
+
+/**
+ * \brief The upper limit of the first latency histogram bucket, in
+ *        microseconds
+ *
+ *  Each following bucket's limit is four times the one before it, and the
+ *  last bucket holds everything else.
+ */
+#define SECURE_SERVICE_LATENCY_FIRST_BUCKET_US  64
+
+/**
+ * \brief Latency statistics for a secure service API
+ *
+ *  Only blocking calls that got a response are measured. All times are in
+ *  microseconds.
+ */
+struct SecureServiceLatencyStats
+{
+    // How many calls were measured
+    uint32_t count;
+
+    // How many calls timed out, which aren't measured
+    uint32_t timeouts;
+
+    // The total time spent in each phase
+    uint64_t phaseTotals[SecureServiceLatency_Count];
+
+    // The longest time spent in each phase
+    uint32_t phaseMaxes[SecureServiceLatency_Count];
+
+    // The shortest and longest round trips
+    uint32_t minTotal;
+    uint32_t maxTotal;
+
+    // How many round trips fell into each bucket
+    uint32_t histogram[SECURE_SERVICE_LATENCY_BUCKET_COUNT];
+};
+
+extern int32_t GetSecureServiceLatency(uint8_t service, uint16_t api, struct SecureServiceLatencyStats *stats);
+
+extern void ResetSecureServiceLatency(void);
+
+/**
+ * \brief The kinds of traced secure service operations
+ */
+enum SecureServiceTrace
+{
+    // A blocking call completed
+    SecureServiceTrace_Call     = 0,
+
+    // An asynchronous call completed
+    SecureServiceTrace_Async    = 1,
+
+    // A blocking call timed out waiting for its response
+    SecureServiceTrace_Timeout  = 2,
+
+    // An asynchronous message was handled
+    SecureServiceTrace_Event    = 3,
+};
+
+/**
+ * \brief A traced secure service operation
+ *
+ *  Times are in cycles.
+ */
+struct SecureServiceTraceEntry
+{
+    // The request, or -- for asynchronous messages -- the asynchronous channel
+    // and the message's event as the API
+    uint32_t request;
+
+    // The result
+    int32_t result;
+
+    // When the operation completed
+    uint32_t timestamp;
+
+    // How long the operation took
+    uint32_t duration;
+
+    // The kind of operation, from enum SecureServiceTrace
+    uint8_t kind;
+};
+
+/**
+ * \brief A request outstanding on a channel
+ */
+struct SecureServiceInFlight
+{
+    // The request
+    uint32_t request;
+
+    // When the request started, in cycles
+    uint32_t start;
+
+    // Whether or not a request is outstanding
+    bool active;
+};
+
+/**
+ * \brief A visitor for traced secure service operations
+ *
+ * \param *entry
+ *      The traced operation
+ * \param *context
+ *      The context provided when visiting
+ *
+ * \return none
+ */
+typedef void (*SecureServiceTraceVisitor)(const struct SecureServiceTraceEntry *entry, void *context);
+
+extern size_t VisitSecureServiceTrace(SecureServiceTraceVisitor visitor, void *context);
+
+extern int32_t GetSecureServiceInFlight(uint8_t channel, struct SecureServiceInFlight *info);
+
+extern void DumpSecureServiceTrace(void);
+
 /**
  * \brief How many channels for secure services are available
  */
@@ -87,6 +318,11 @@ enum SecureService
     SecureService_Net       = 3,
 };
 
+/**
+ * \brief How many secure services there are
+ */
+#define SECURE_SERVICE_COUNT            (SecureService_Net + 1)
+
 /**
  * \brief Creates a 32-bit request value from a service and an API
  *
@@ -193,5 +429,95 @@ namespace NimbeLink::Sdk::SecureServices
     {
         return CallSecureService(service, api, &parameters, sizeof(T));
     }
+
+    static inline int32_t Call(uint8_t service, uint16_t api, void *parameters, uint32_t size, k_timeout_t timeout)
+    {
+        return CallSecureServiceTimeout(service, api, parameters, size, timeout);
+    }
+
+    template <typename T>
+    static inline int32_t Call(uint8_t service, uint16_t api, T &parameters, k_timeout_t timeout)
+    {
+        return CallSecureServiceTimeout(service, api, &parameters, sizeof(T), timeout);
+    }
+
+    using BatchEntry = SecureServiceBatchEntry;
+
+    static inline int32_t CallBatch(BatchEntry *entries, std::size_t count)
+    {
+        return CallSecureServiceBatch(entries, count);
+    }
+
+    using Callback = SecureServiceCallback;
+
+    static inline int32_t CallAsync(uint8_t service, uint16_t api, void *parameters, uint32_t size, Callback callback, void *context = nullptr)
+    {
+        return CallSecureServiceAsync(service, api, parameters, size, callback, context);
+    }
+
+    template <typename T>
+    static inline int32_t CallAsync(uint8_t service, uint16_t api, T &parameters, Callback callback, void *context = nullptr)
+    {
+        return CallSecureServiceAsync(service, api, &parameters, sizeof(T), callback, context);
+    }
+
+    struct _LatencyPhase
+    {
+        enum _E
+        {
+            Reserve = SecureServiceLatency_Reserve,
+            Put     = SecureServiceLatency_Put,
+            Secure  = SecureServiceLatency_Secure,
+            Wake    = SecureServiceLatency_Wake,
+            Get     = SecureServiceLatency_Get,
+            Count   = SecureServiceLatency_Count,
+        };
+    };
+
+    using LatencyPhase = _LatencyPhase::_E;
+
+    using LatencyStats = SecureServiceLatencyStats;
+
+    static inline int32_t GetLatency(uint8_t service, uint16_t api, LatencyStats &stats)
+    {
+        return GetSecureServiceLatency(service, api, &stats);
+    }
+
+    static inline void ResetLatency(void)
+    {
+        ResetSecureServiceLatency();
+    }
+
+    struct _TraceKind
+    {
+        enum _E
+        {
+            Call    = SecureServiceTrace_Call,
+            Async   = SecureServiceTrace_Async,
+            Timeout = SecureServiceTrace_Timeout,
+            Event   = SecureServiceTrace_Event,
+        };
+    };
+
+    using TraceKind = _TraceKind::_E;
+
+    using TraceEntry = SecureServiceTraceEntry;
+    using InFlight = SecureServiceInFlight;
+    using TraceVisitor = SecureServiceTraceVisitor;
+
+    static inline std::size_t VisitTrace(TraceVisitor visitor, void *context = nullptr)
+    {
+        return VisitSecureServiceTrace(visitor, context);
+    }
+
+    static inline int32_t GetInFlight(uint8_t channel, InFlight &info)
+    {
+        return GetSecureServiceInFlight(channel, &info);
+    }
+
+    static inline void DumpTrace(void)
+    {
+        DumpSecureServiceTrace();
+    }
 }
 #endif
@@ -0,0 +1,130 @@
+/**
+ * \file
+ *
+ * \brief Controls the host-side Secure firmware emulator
+ *
+ *  These are only available when CONFIG_SECURE_SERVICES_EMULATOR is enabled,
+ *  and let tests and benchmarks script the emulated stack firmware.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nimbelink/sdk/secure_services/at.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Adds a scripted AT command response
+ *
+ *  Commands starting with the prefix are answered with the response, and the
+ *  longest matching prefix wins. Adding a prefix that already has a response
+ *  replaces it. Commands without a matching prefix succeed with an empty
+ *  response.
+ *
+ *  The strings aren't copied, so they must remain valid until the response is
+ *  cleared.
+ *
+ * \param *prefix
+ *      The command prefix to respond to
+ * \param *response
+ *      The response to give
+ * \param result
+ *      The command result to give
+ * \param error
+ *      The error value to give with a CME/CMS result
+ *
+ * \return -EINVAL
+ *      Invalid parameters
+ * \return -ENOMEM
+ *      No more room for scripted responses
+ * \return 0
+ *      Response added
+ */
+int Emulator_AddAtResponse(const char *prefix, const char *response, enum At_Result result, int32_t error);
+
+/**
+ * \brief Clears all scripted AT command responses
+ *
+ * \param none
+ *
+ * \return none
+ */
+void Emulator_ClearAtResponses(void);
+
+/**
+ * \brief Sends an asynchronous message from the emulated Secure firmware
+ *
+ *  This must not be called from an interrupt.
+ *
+ * \param event
+ *      The message's event
+ * \param *data
+ *      The message's data
+ * \param length
+ *      The length of the message's data
+ *
+ * \return -EINVAL
+ *      Message too long
+ * \return -ENOMEM
+ *      Too many messages already queued
+ * \return 0
+ *      Message sent
+ */
+int Emulator_SendAsync(uint32_t event, const void *data, size_t length);
+
+/**
+ * \brief Sends an AT URC from the emulated Secure firmware
+ *
+ * \param *urc
+ *      The URC to send
+ *
+ * \return -EINVAL
+ *      URC too long
+ * \return -ENOMEM
+ *      Too many messages already queued
+ * \return 0
+ *      URC sent
+ */
+int Emulator_SendUrc(const char *urc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+namespace NimbeLink::Sdk::SecureServices::Emulator
+{
+    static inline int AddAtResponse(const char *prefix, const char *response, At::Result result = At::Result::Success, int32_t error = 0)
+    {
+        return Emulator_AddAtResponse(prefix, response, static_cast<enum At_Result>(result), error);
+    }
+
+    static inline void ClearAtResponses(void)
+    {
+        Emulator_ClearAtResponses();
+    }
+
+    static inline int SendAsync(uint32_t event, const void *data, std::size_t length)
+    {
+        return Emulator_SendAsync(event, data, length);
+    }
+
+    static inline int SendUrc(const char *urc)
+    {
+        return Emulator_SendUrc(urc);
+    }
+}
+#endif
@@ -0,0 +1,189 @@
+/**
+ * \file
+ *
+ * \brief Emulates the Secure firmware's AT service with scripted responses
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr.h>
+
+#include "nimbelink/sdk/secure_services/at.h"
+#include "nimbelink/sdk/secure_services/emulator.h"
+#include "nimbelink/sdk/secure_services/emulator/services.h"
+
+/**
+ * \brief A scripted AT command response
+ */
+struct EmulatorAtResponse
+{
+    // The command prefix this responds to, or NULL if unused
+    const char *prefix;
+
+    // The response to give
+    const char *response;
+
+    // The command result to give
+    enum At_Result result;
+
+    // The error value to give
+    int32_t error;
+};
+
+static struct EmulatorAtResponse atResponses[CONFIG_SECURE_SERVICES_EMULATOR_AT_RESPONSES];
+
+static K_MUTEX_DEFINE(atLock);
+
+int Emulator_AddAtResponse(const char *prefix, const char *response, enum At_Result result, int32_t error)
+{
+    if ((prefix == NULL) || (response == NULL))
+    {
+        return -EINVAL;
+    }
+
+    struct EmulatorAtResponse *free = NULL;
+
+    k_mutex_lock(&atLock, K_FOREVER);
+
+    for (size_t i = 0; i < ARRAY_SIZE(atResponses); i++)
+    {
+        // If this prefix already has a response, replace it
+        if ((atResponses[i].prefix != NULL) && (strcmp(atResponses[i].prefix, prefix) == 0))
+        {
+            free = &(atResponses[i]);
+            break;
+        }
+
+        if ((free == NULL) && (atResponses[i].prefix == NULL))
+        {
+            free = &(atResponses[i]);
+        }
+    }
+
+    if (free != NULL)
+    {
+        free->prefix = prefix;
+        free->response = response;
+        free->result = result;
+        free->error = error;
+    }
+
+    k_mutex_unlock(&atLock);
+
+    return (free != NULL) ? 0 : -ENOMEM;
+}
+
+void Emulator_ClearAtResponses(void)
+{
+    k_mutex_lock(&atLock, K_FOREVER);
+
+    memset(atResponses, 0, sizeof(atResponses));
+
+    k_mutex_unlock(&atLock);
+}
+
+/**
+ * \brief Runs an emulated AT command
+ *
+ * \param *parameters
+ *      The command's parameters
+ *
+ * \return -EINVAL
+ *      Invalid parameters
+ * \return 0
+ *      Command run
+ */
+static int32_t RunCommand(struct At_RunCommandParameters *parameters)
+{
+    if ((parameters->command == NULL) || ((parameters->response == NULL) && (parameters->maxLength > 0)))
+    {
+        return -EINVAL;
+    }
+
+    const struct EmulatorAtResponse *match = NULL;
+    size_t matchLength = 0;
+
+    k_mutex_lock(&atLock, K_FOREVER);
+
+    // Find the longest matching prefix
+    for (size_t i = 0; i < ARRAY_SIZE(atResponses); i++)
+    {
+        if (atResponses[i].prefix == NULL)
+        {
+            continue;
+        }
+
+        size_t length = strlen(atResponses[i].prefix);
+
+        if ((length <= parameters->commandLength) &&
+            (length >= matchLength) &&
+            (strncmp(parameters->command, atResponses[i].prefix, length) == 0))
+        {
+            match = &(atResponses[i]);
+            matchLength = length;
+        }
+    }
+
+    const char *response = (match != NULL) ? match->response : "";
+
+    parameters->result = (match != NULL) ? match->result : At_Result_Success;
+    parameters->error.value = (match != NULL) ? match->error : 0;
+
+    // Give as much of the response as fits
+    size_t length = strlen(response);
+
+    if (parameters->maxLength > 0)
+    {
+        if (length > (parameters->maxLength - 1))
+        {
+            length = parameters->maxLength - 1;
+        }
+
+        memcpy(parameters->response, response, length);
+        parameters->response[length] = '\0';
+    }
+    else
+    {
+        length = 0;
+    }
+
+    parameters->responseLength = length;
+
+    k_mutex_unlock(&atLock);
+
+    return 0;
+}
+
+int32_t Emulator_HandleAt(uint16_t api, void *parameters, uint32_t size)
+{
+    switch ((enum At_Api)api)
+    {
+        case At_Api_RunCommand:
+        {
+            if ((parameters == NULL) || (size != sizeof(struct At_RunCommandParameters)))
+            {
+                return -EINVAL;
+            }
+
+            return RunCommand((struct At_RunCommandParameters *)parameters);
+        }
+
+        // URC subscriptions are handled by the Non-Secure side
+        case At_Api_SubscribeUrcs:
+        {
+            break;
+        }
+    }
+
+    return -ENOTSUP;
+}
@@ -0,0 +1,409 @@
+/**
+ * \file
+ *
+ * \brief Emulates the Secure firmware's secure service transport on the host
+ *
+ *  Each bidirectional channel has a worker thread standing in for the Secure
+ *  firmware. Queuing a request copies its parameters and wakes the channel's
+ *  worker, which handles the request and then signals the response the same
+ *  way the EGU2 interrupt would on hardware.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <device.h>
+#include <init.h>
+#include <zephyr.h>
+
+#include "nimbelink/sdk/secure_services/async.h"
+#include "nimbelink/sdk/secure_services/call.h"
+#include "nimbelink/sdk/secure_services/emulator.h"
+#include "nimbelink/sdk/secure_services/kernel.h"
+#include "nimbelink/sdk/secure_services/emulator/services.h"
+#include "nimbelink/sdk/secure_services/zephyr/transport.h"
+
+/**
+ * \brief The largest parameter structure the emulator will copy
+ */
+#define EMULATOR_PARAMETERS_MAX_SIZE    128
+
+/**
+ * \brief A bidirectional channel's emulated Secure firmware state
+ */
+struct EmulatorChannel
+{
+    // Signals the worker that a request was queued
+    struct k_sem pending;
+
+    // The queued request
+    uint32_t request;
+
+    // A copy of the request's parameters, updated with the response
+    uint32_t parameters[EMULATOR_PARAMETERS_MAX_SIZE / sizeof(uint32_t)];
+
+    // The size of the request's parameters
+    uint32_t size;
+
+    // The result of the request
+    int32_t result;
+};
+
+/**
+ * \brief An emulated asynchronous message
+ */
+struct EmulatorAsyncMessage
+{
+    // The length of the message's data
+    uint32_t length;
+
+    // The message
+    struct Async_Parameters parameters;
+};
+
+static struct EmulatorChannel emulatorChannels[SECURE_SERVICE_CHANNEL_COUNT];
+
+static struct k_thread workers[SECURE_SERVICE_CHANNEL_COUNT];
+
+static K_THREAD_STACK_ARRAY_DEFINE(workerStacks, SECURE_SERVICE_CHANNEL_COUNT, CONFIG_SECURE_SERVICES_EMULATOR_STACK_SIZE);
+
+// Asynchronous messages waiting to be retrieved
+K_MSGQ_DEFINE(asyncMessages, sizeof(struct EmulatorAsyncMessage), CONFIG_SECURE_SERVICES_EMULATOR_ASYNC_DEPTH, 4);
+
+// Storage for the asynchronous message being retrieved
+//
+// Only the asynchronous message thread retrieves messages, and its stack is
+// too small for one of these.
+static struct EmulatorAsyncMessage asyncMessage;
+
+// Storage for the asynchronous message being sent
+//
+// Messages can be sent from any thread, so this keeps them off the senders'
+// stacks.
+static struct EmulatorAsyncMessage sendMessage;
+
+// A lock for the asynchronous message being sent
+static K_MUTEX_DEFINE(sendLock);
+
+// Whether or not the workers are running yet
+static bool started = false;
+
+/**
+ * \brief Handles a request
+ *
+ * \param request
+ *      The request
+ * \param *parameters
+ *      The request's parameters
+ * \param size
+ *      The size of the parameters
+ *
+ * \return int32_t
+ *      The result of the request
+ */
+static int32_t HandleRequest(uint32_t request, void *parameters, uint32_t size)
+{
+    // If there aren't any parameters, don't give the services a pointer to our
+    // copy
+    if (size == 0)
+    {
+        parameters = NULL;
+    }
+
+    switch (GET_SERVICE(request))
+    {
+        case SecureService_Kernel:
+            return Emulator_HandleKernel(GET_API(request), parameters, size);
+
+        case SecureService_At:
+            return Emulator_HandleAt(GET_API(request), parameters, size);
+
+        case SecureService_App:
+            return Emulator_HandleApp(GET_API(request), parameters, size);
+
+        case SecureService_Net:
+            return Emulator_HandleNet(GET_API(request), parameters, size);
+    }
+
+    return -ENOTSUP;
+}
+
+/**
+ * \brief Handles a channel's requests
+ *
+ * \param *p1
+ *      The channel's index
+ * \param *p2
+ *      Unused
+ * \param *p3
+ *      Unused
+ *
+ * \return none
+ */
+static void RunWorker(void *p1, void *p2, void *p3)
+{
+    (void)p2;
+    (void)p3;
+
+    size_t index = (size_t)(uintptr_t)p1;
+
+    struct EmulatorChannel *channel = &(emulatorChannels[index]);
+
+    while (true)
+    {
+        k_sem_take(&(channel->pending), K_FOREVER);
+
+        channel->result = HandleRequest(channel->request, channel->parameters, channel->size);
+
+    #if CONFIG_SECURE_SERVICES_EMULATOR_LATENCY_US > 0
+        k_usleep(CONFIG_SECURE_SERVICES_EMULATOR_LATENCY_US);
+    #endif
+
+        SignalSecureServiceChannel(index);
+    }
+}
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+/**
+ * \brief Gets as many asynchronous messages as fit in a batch
+ *
+ * \param *batch
+ *      The batch
+ * \param size
+ *      The size of the batch
+ *
+ * \return -EINVAL
+ *      Invalid batch
+ * \return 0
+ *      Batch filled in, possibly with nothing
+ */
+static int32_t GetAsyncMessages(struct Async_BatchParameters *batch, uint32_t size)
+{
+    if ((batch == NULL) || (size < sizeof(*batch)))
+    {
+        return -EINVAL;
+    }
+
+    uint32_t maxCount = batch->count;
+    uint32_t count = 0;
+
+    size_t offset = 0;
+    size_t space = size - sizeof(*batch);
+
+    // We're the only consumer, so the message we peek at will still be there
+    // when we take it
+    while ((count < maxCount) && (k_msgq_peek(&asyncMessages, &asyncMessage) == 0))
+    {
+        size_t needed = ASYNC_BATCH_MESSAGE_SIZE(asyncMessage.length);
+
+        if (needed > (space - offset))
+        {
+            break;
+        }
+
+        struct Async_BatchMessage *message = (struct Async_BatchMessage *)&(batch->messages[offset]);
+
+        message->event = asyncMessage.parameters.event;
+        message->length = asyncMessage.length;
+
+        memcpy(message->data, asyncMessage.parameters.buffer, asyncMessage.length);
+
+        k_msgq_get(&asyncMessages, &asyncMessage, K_NO_WAIT);
+
+        offset += needed;
+        count++;
+    }
+
+    batch->count = count;
+
+    return 0;
+}
+#endif
+
+int32_t __PutSecureServiceRequest(uint32_t request, void *parameters, uint32_t size)
+{
+    if (!started)
+    {
+        return -EAGAIN;
+    }
+
+    // PendSV never needs a response, and there's no Secure world to hand it to
+    if ((GET_SERVICE(request) == SecureService_Kernel) && (GET_API(request) == Kernel_Api_PendSv))
+    {
+        return 1;
+    }
+
+    uint8_t index = GET_CHANNEL(request);
+
+    if ((index >= SECURE_SERVICE_CHANNEL_COUNT) || (size > sizeof(emulatorChannels[0].parameters)))
+    {
+        return -EINVAL;
+    }
+
+    if ((size > 0) && (parameters == NULL))
+    {
+        return -EINVAL;
+    }
+
+    struct EmulatorChannel *channel = &(emulatorChannels[index]);
+
+    channel->request = request;
+    channel->size = size;
+
+    if (size > 0)
+    {
+        memcpy(channel->parameters, parameters, size);
+    }
+
+    k_sem_give(&(channel->pending));
+
+    return 0;
+}
+
+int32_t __GetSecureServiceResponse(uint32_t request, void *parameters, uint32_t size)
+{
+    if (!started)
+    {
+        return -EAGAIN;
+    }
+
+    uint8_t index = GET_CHANNEL(request);
+
+    // If this is the asynchronous channel, hand over the next messages, if any
+    if (index == SECURE_SERVICE_ASYNC_CHANNEL)
+    {
+    #if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+        if (GET_API(request) == Async_Api_GetMessages)
+        {
+            return GetAsyncMessages(parameters, size);
+        }
+    #endif
+
+        if ((parameters == NULL) || (size < sizeof(struct Async_Parameters)))
+        {
+            return -EINVAL;
+        }
+
+        int32_t result = k_msgq_get(&asyncMessages, &asyncMessage, K_NO_WAIT);
+
+        if (result == 0)
+        {
+            memcpy(parameters, &(asyncMessage.parameters), sizeof(asyncMessage.parameters));
+        }
+
+        return result;
+    }
+
+    if (index >= SECURE_SERVICE_CHANNEL_COUNT)
+    {
+        return -EINVAL;
+    }
+
+    struct EmulatorChannel *channel = &(emulatorChannels[index]);
+
+    // Pass back anything the response updated
+    if (size > channel->size)
+    {
+        size = channel->size;
+    }
+
+    if ((size > 0) && (parameters != NULL))
+    {
+        memcpy(parameters, channel->parameters, size);
+    }
+
+    return channel->result;
+}
+
+int Emulator_SendAsync(uint32_t event, const void *data, size_t length)
+{
+    if ((length > sizeof(sendMessage.parameters.buffer)) || ((length > 0) && (data == NULL)))
+    {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&sendLock, K_FOREVER);
+
+    sendMessage.length = length;
+    sendMessage.parameters.event = event;
+
+    if (length > 0)
+    {
+        memcpy(sendMessage.parameters.buffer, data, length);
+    }
+
+    memset(&(sendMessage.parameters.buffer[length]), 0, sizeof(sendMessage.parameters.buffer) - length);
+
+    // If the queue is full, the message is dropped, much like the Secure
+    // firmware would have to
+    int result = k_msgq_put(&asyncMessages, &sendMessage, K_NO_WAIT);
+
+    k_mutex_unlock(&sendLock);
+
+    if (result != 0)
+    {
+        return -ENOMEM;
+    }
+
+    SignalSecureServiceChannel(SECURE_SERVICE_ASYNC_CHANNEL);
+
+    return 0;
+}
+
+int Emulator_SendUrc(const char *urc)
+{
+    if (urc == NULL)
+    {
+        return -EINVAL;
+    }
+
+    // Include the NULL byte
+    return Emulator_SendAsync(Async_Event_AtUrc, urc, strlen(urc) + 1);
+}
+
+/**
+ * \brief Starts the emulated Secure firmware
+ *
+ * \param *device
+ *      Unused
+ *
+ * \return 0
+ *      Always
+ */
+static int StartEmulator(const struct device *device)
+{
+    (void)device;
+
+    for (size_t i = 0; i < SECURE_SERVICE_CHANNEL_COUNT; i++)
+    {
+        k_sem_init(&(emulatorChannels[i].pending), 0, 1);
+
+        k_thread_create(
+            &(workers[i]),
+            workerStacks[i],
+            K_THREAD_STACK_SIZEOF(workerStacks[i]),
+            RunWorker,
+            (void *)(uintptr_t)i,
+            NULL,
+            NULL,
+            CONFIG_SECURE_SERVICES_EMULATOR_THREAD_PRIORITY,
+            0,
+            K_NO_WAIT
+        );
+    }
+
+    started = true;
+
+    return 0;
+}
+
+SYS_INIT(StartEmulator, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
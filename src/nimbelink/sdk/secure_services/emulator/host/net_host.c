@@ -0,0 +1,532 @@
+/**
+ * \file
+ *
+ * \brief Host socket operations for the Secure firmware emulator
+ *
+ *  This is built against the host's C library rather than Zephyr's, so it
+ *  can't use any Zephyr APIs.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "net_host.h"
+
+/**
+ * \brief Gets the neutral form of a host errno value
+ *
+ * \param value
+ *      The errno value
+ *
+ * \return enum NetHost_Error
+ *      The neutral error
+ */
+static enum NetHost_Error GetError(int value)
+{
+    switch (value)
+    {
+        case EAGAIN:
+    #if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+    #endif
+            return NetHost_Error_Again;
+
+        case EINPROGRESS:       return NetHost_Error_InProgress;
+        case EALREADY:          return NetHost_Error_Already;
+        case EINVAL:            return NetHost_Error_Invalid;
+        case ENOMEM:
+        case ENOBUFS:
+        case EMFILE:
+        case ENFILE:            return NetHost_Error_NoMemory;
+        case EBADF:
+        case ENOTSOCK:          return NetHost_Error_BadFd;
+        case EADDRINUSE:        return NetHost_Error_AddressInUse;
+        case EADDRNOTAVAIL:     return NetHost_Error_AddressNotAvailable;
+        case ECONNREFUSED:      return NetHost_Error_ConnectionRefused;
+        case ECONNRESET:        return NetHost_Error_ConnectionReset;
+        case ECONNABORTED:      return NetHost_Error_ConnectionAborted;
+        case ENOTCONN:          return NetHost_Error_NotConnected;
+        case EISCONN:           return NetHost_Error_IsConnected;
+        case ETIMEDOUT:         return NetHost_Error_TimedOut;
+        case EHOSTUNREACH:      return NetHost_Error_HostUnreachable;
+        case ENETUNREACH:       return NetHost_Error_NetworkUnreachable;
+        case EPIPE:             return NetHost_Error_Pipe;
+        case EMSGSIZE:          return NetHost_Error_MessageSize;
+        case EOPNOTSUPP:        return NetHost_Error_NotSupported;
+        case EAFNOSUPPORT:      return NetHost_Error_FamilyNotSupported;
+        case EPROTONOSUPPORT:   return NetHost_Error_ProtocolNotSupported;
+        case EINTR:             return NetHost_Error_Interrupted;
+        default:                return NetHost_Error_Other;
+    }
+}
+
+/**
+ * \brief Gets the result of a failed host call
+ *
+ * \param none
+ *
+ * \return int
+ *      The negative neutral error
+ */
+static inline int Fail(void)
+{
+    return -(int)GetError(errno);
+}
+
+/**
+ * \brief Converts a neutral address to a host one
+ *
+ * \param *address
+ *      The neutral address
+ * \param *storage
+ *      Where to store the host address
+ *
+ * \return 0
+ *      Unsupported address family
+ * \return socklen_t
+ *      The host address's length
+ */
+static socklen_t ToHostAddress(const struct NetHostAddress *address, struct sockaddr_storage *storage)
+{
+    memset(storage, 0, sizeof(*storage));
+
+    if (address->family == NetHost_Family_Inet)
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)storage;
+
+        in->sin_family = AF_INET;
+        in->sin_port = htons(address->port);
+        memcpy(&(in->sin_addr), address->address, sizeof(in->sin_addr));
+
+        return sizeof(*in);
+    }
+
+    if (address->family == NetHost_Family_Inet6)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)storage;
+
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(address->port);
+        in6->sin6_scope_id = address->scope;
+        memcpy(&(in6->sin6_addr), address->address, sizeof(in6->sin6_addr));
+
+        return sizeof(*in6);
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Converts a host address to a neutral one
+ *
+ * \param *sa
+ *      The host address
+ * \param *address
+ *      Where to store the neutral address
+ *
+ * \return none
+ */
+static void FromHostAddress(const struct sockaddr *sa, struct NetHostAddress *address)
+{
+    memset(address, 0, sizeof(*address));
+
+    if (sa->sa_family == AF_INET)
+    {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)sa;
+
+        address->family = NetHost_Family_Inet;
+        address->port = ntohs(in->sin_port);
+        memcpy(address->address, &(in->sin_addr), sizeof(in->sin_addr));
+    }
+    else if (sa->sa_family == AF_INET6)
+    {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)sa;
+
+        address->family = NetHost_Family_Inet6;
+        address->port = ntohs(in6->sin6_port);
+        address->scope = in6->sin6_scope_id;
+        memcpy(address->address, &(in6->sin6_addr), sizeof(in6->sin6_addr));
+    }
+}
+
+/**
+ * \brief Converts a neutral socket option to a host one
+ *
+ * \param option
+ *      The neutral option
+ * \param *level
+ *      Where to store the option's level
+ * \param *name
+ *      Where to store the option's name
+ *
+ * \return true
+ *      Option converted
+ * \return false
+ *      Option unsupported
+ */
+static bool ToHostOption(enum NetHost_Option option, int *level, int *name)
+{
+    switch (option)
+    {
+        case NetHost_Option_ReuseAddress:
+            *level = SOL_SOCKET;
+            *name = SO_REUSEADDR;
+            return true;
+
+        case NetHost_Option_KeepAlive:
+            *level = SOL_SOCKET;
+            *name = SO_KEEPALIVE;
+            return true;
+
+        case NetHost_Option_NoDelay:
+            *level = IPPROTO_TCP;
+            *name = TCP_NODELAY;
+            return true;
+
+        case NetHost_Option_Broadcast:
+            *level = SOL_SOCKET;
+            *name = SO_BROADCAST;
+            return true;
+    }
+
+    return false;
+}
+
+int NetHost_Socket(enum NetHost_Family family, enum NetHost_Type type, int protocol)
+{
+    int hostFamily = (family == NetHost_Family_Inet6) ? AF_INET6 : AF_INET;
+    int hostType = (type == NetHost_Type_Datagram) ? SOCK_DGRAM : SOCK_STREAM;
+
+    int fd = socket(hostFamily, hostType | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+
+    return (fd < 0) ? Fail() : fd;
+}
+
+int NetHost_Close(int fd)
+{
+    return (close(fd) < 0) ? Fail() : 0;
+}
+
+int NetHost_Accept(int fd, struct NetHostAddress *address)
+{
+    struct sockaddr_storage storage;
+    socklen_t length = sizeof(storage);
+
+    int result = accept4(fd, (struct sockaddr *)&storage, &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (result < 0)
+    {
+        return Fail();
+    }
+
+    if (address != NULL)
+    {
+        FromHostAddress((const struct sockaddr *)&storage, address);
+    }
+
+    return result;
+}
+
+int NetHost_Bind(int fd, const struct NetHostAddress *address)
+{
+    struct sockaddr_storage storage;
+    socklen_t length = ToHostAddress(address, &storage);
+
+    if (length == 0)
+    {
+        return -NetHost_Error_FamilyNotSupported;
+    }
+
+    return (bind(fd, (const struct sockaddr *)&storage, length) < 0) ? Fail() : 0;
+}
+
+int NetHost_Listen(int fd, int backlog)
+{
+    return (listen(fd, backlog) < 0) ? Fail() : 0;
+}
+
+int NetHost_Connect(int fd, const struct NetHostAddress *address)
+{
+    struct sockaddr_storage storage;
+    socklen_t length = ToHostAddress(address, &storage);
+
+    if (length == 0)
+    {
+        return -NetHost_Error_FamilyNotSupported;
+    }
+
+    return (connect(fd, (const struct sockaddr *)&storage, length) < 0) ? Fail() : 0;
+}
+
+int NetHost_GetError(int fd)
+{
+    int value = 0;
+    socklen_t length = sizeof(value);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &value, &length) < 0)
+    {
+        return Fail();
+    }
+
+    return (value == 0) ? 0 : (int)GetError(value);
+}
+
+int NetHost_SetOption(int fd, enum NetHost_Option option, int value)
+{
+    int level;
+    int name;
+
+    if (!ToHostOption(option, &level, &name))
+    {
+        return -NetHost_Error_NotSupported;
+    }
+
+    return (setsockopt(fd, level, name, &value, sizeof(value)) < 0) ? Fail() : 0;
+}
+
+int NetHost_GetOption(int fd, enum NetHost_Option option, int *value)
+{
+    int level;
+    int name;
+    socklen_t length = sizeof(*value);
+
+    if (!ToHostOption(option, &level, &name))
+    {
+        return -NetHost_Error_NotSupported;
+    }
+
+    return (getsockopt(fd, level, name, value, &length) < 0) ? Fail() : 0;
+}
+
+int NetHost_Recv(int fd, void *buffer, size_t length, uint32_t flags, struct NetHostAddress *from)
+{
+    struct sockaddr_storage storage;
+    socklen_t storageLength = sizeof(storage);
+
+    int hostFlags = MSG_DONTWAIT;
+
+    if ((flags & NET_HOST_MSG_PEEK) != 0)
+    {
+        hostFlags |= MSG_PEEK;
+    }
+
+    // Waiting for everything is left to the caller, since the socket never
+    // blocks
+    storage.ss_family = AF_UNSPEC;
+
+    ssize_t result = recvfrom(fd, buffer, length, hostFlags, (struct sockaddr *)&storage, &storageLength);
+
+    if (result < 0)
+    {
+        return Fail();
+    }
+
+    if (from != NULL)
+    {
+        FromHostAddress((const struct sockaddr *)&storage, from);
+    }
+
+    return (int)result;
+}
+
+int NetHost_Send(int fd, const void *buffer, size_t length, uint32_t flags, const struct NetHostAddress *to)
+{
+    (void)flags;
+
+    struct sockaddr_storage storage;
+    socklen_t storageLength = 0;
+
+    if (to != NULL)
+    {
+        storageLength = ToHostAddress(to, &storage);
+
+        if (storageLength == 0)
+        {
+            return -NetHost_Error_FamilyNotSupported;
+        }
+    }
+
+    // Don't let a closed peer take the whole process down with SIGPIPE
+    ssize_t result = sendto(
+        fd,
+        buffer,
+        length,
+        MSG_DONTWAIT | MSG_NOSIGNAL,
+        (to != NULL) ? (const struct sockaddr *)&storage : NULL,
+        storageLength
+    );
+
+    return (result < 0) ? Fail() : (int)result;
+}
+
+int NetHost_Poll(struct NetHostPollFd *fds, size_t count)
+{
+    struct pollfd hostFds[count];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        hostFds[i].fd = fds[i].fd;
+        hostFds[i].events = 0;
+        hostFds[i].revents = 0;
+
+        if ((fds[i].events & NET_HOST_POLLIN) != 0)
+        {
+            hostFds[i].events |= POLLIN;
+        }
+
+        if ((fds[i].events & NET_HOST_POLLOUT) != 0)
+        {
+            hostFds[i].events |= POLLOUT;
+        }
+    }
+
+    // Never block, so the rest of the emulated system keeps running
+    int result = poll(hostFds, count, 0);
+
+    if (result < 0)
+    {
+        return Fail();
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        fds[i].revents = 0;
+
+        if ((hostFds[i].revents & POLLIN) != 0)
+        {
+            fds[i].revents |= NET_HOST_POLLIN;
+        }
+
+        if ((hostFds[i].revents & POLLOUT) != 0)
+        {
+            fds[i].revents |= NET_HOST_POLLOUT;
+        }
+
+        if ((hostFds[i].revents & POLLERR) != 0)
+        {
+            fds[i].revents |= NET_HOST_POLLERR;
+        }
+
+        if ((hostFds[i].revents & POLLHUP) != 0)
+        {
+            fds[i].revents |= NET_HOST_POLLHUP;
+        }
+
+        if ((hostFds[i].revents & POLLNVAL) != 0)
+        {
+            fds[i].revents |= NET_HOST_POLLNVAL;
+        }
+    }
+
+    return result;
+}
+
+int NetHost_Resolve(
+    const char *node,
+    const char *service,
+    enum NetHost_Family family,
+    enum NetHost_Type type,
+    bool passive,
+    struct NetHostAddrInfo *results,
+    size_t count,
+    char *canonicalName,
+    size_t nameLength
+)
+{
+    struct addrinfo hints;
+
+    memset(&hints, 0, sizeof(hints));
+
+    switch (family)
+    {
+        case NetHost_Family_Inet:   hints.ai_family = AF_INET;      break;
+        case NetHost_Family_Inet6:  hints.ai_family = AF_INET6;     break;
+        default:                    hints.ai_family = AF_UNSPEC;    break;
+    }
+
+    switch (type)
+    {
+        case NetHost_Type_Stream:   hints.ai_socktype = SOCK_STREAM;    break;
+        case NetHost_Type_Datagram: hints.ai_socktype = SOCK_DGRAM;     break;
+        default:                    hints.ai_socktype = 0;              break;
+    }
+
+    if (passive)
+    {
+        hints.ai_flags |= AI_PASSIVE;
+    }
+
+    if (canonicalName != NULL)
+    {
+        hints.ai_flags |= AI_CANONNAME;
+    }
+
+    struct addrinfo *infos;
+
+    int result = getaddrinfo(node, service, &hints, &infos);
+
+    if (result != 0)
+    {
+        switch (result)
+        {
+            case EAI_AGAIN:     return -NetHost_ResolveError_Again;
+            case EAI_NONAME:    return -NetHost_ResolveError_NoName;
+            case EAI_FAMILY:    return -NetHost_ResolveError_Family;
+            case EAI_SOCKTYPE:  return -NetHost_ResolveError_SocketType;
+            case EAI_SERVICE:   return -NetHost_ResolveError_Service;
+            case EAI_MEMORY:    return -NetHost_ResolveError_Memory;
+            default:            return -NetHost_ResolveError_Fail;
+        }
+    }
+
+    if ((canonicalName != NULL) && (nameLength > 0))
+    {
+        canonicalName[0] = '\0';
+
+        if (infos->ai_canonname != NULL)
+        {
+            strncpy(canonicalName, infos->ai_canonname, nameLength - 1);
+            canonicalName[nameLength - 1] = '\0';
+        }
+    }
+
+    int stored = 0;
+
+    for (struct addrinfo *info = infos; (info != NULL) && ((size_t)stored < count); info = info->ai_next)
+    {
+        // Skip anything we can't represent
+        if ((info->ai_family != AF_INET) && (info->ai_family != AF_INET6))
+        {
+            continue;
+        }
+
+        struct NetHostAddrInfo *entry = &(results[stored]);
+
+        entry->family = (info->ai_family == AF_INET6) ? NetHost_Family_Inet6 : NetHost_Family_Inet;
+        entry->type = (info->ai_socktype == SOCK_DGRAM) ? NetHost_Type_Datagram : NetHost_Type_Stream;
+        entry->protocol = info->ai_protocol;
+
+        FromHostAddress(info->ai_addr, &(entry->address));
+
+        stored++;
+    }
+
+    freeaddrinfo(infos);
+
+    return (stored > 0) ? stored : -NetHost_ResolveError_NoName;
+}
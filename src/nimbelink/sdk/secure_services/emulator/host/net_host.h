@@ -0,0 +1,202 @@
+/**
+ * \file
+ *
+ * \brief Host socket operations for the Secure firmware emulator
+ *
+ *  The emulated networking service can't include the host's socket headers
+ *  alongside Zephyr's, so the host sockets are wrapped here with neutral
+ *  types and values that both sides agree on. Every host socket is
+ *  non-blocking; blocking behavior is left to the caller.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Errors reported by the host socket operations
+ *
+ *  Failing operations return the negative of one of these.
+ */
+enum NetHost_Error
+{
+    NetHost_Error_Other             = 1,
+    NetHost_Error_Again,
+    NetHost_Error_InProgress,
+    NetHost_Error_Already,
+    NetHost_Error_Invalid,
+    NetHost_Error_NoMemory,
+    NetHost_Error_BadFd,
+    NetHost_Error_AddressInUse,
+    NetHost_Error_AddressNotAvailable,
+    NetHost_Error_ConnectionRefused,
+    NetHost_Error_ConnectionReset,
+    NetHost_Error_ConnectionAborted,
+    NetHost_Error_NotConnected,
+    NetHost_Error_IsConnected,
+    NetHost_Error_TimedOut,
+    NetHost_Error_HostUnreachable,
+    NetHost_Error_NetworkUnreachable,
+    NetHost_Error_Pipe,
+    NetHost_Error_MessageSize,
+    NetHost_Error_NotSupported,
+    NetHost_Error_FamilyNotSupported,
+    NetHost_Error_ProtocolNotSupported,
+    NetHost_Error_Interrupted,
+};
+
+/**
+ * \brief Errors reported by the host name resolution
+ */
+enum NetHost_ResolveError
+{
+    NetHost_ResolveError_Fail       = 1,
+    NetHost_ResolveError_Again,
+    NetHost_ResolveError_NoName,
+    NetHost_ResolveError_Family,
+    NetHost_ResolveError_SocketType,
+    NetHost_ResolveError_Service,
+    NetHost_ResolveError_Memory,
+};
+
+enum NetHost_Family
+{
+    NetHost_Family_Unspecified      = 0,
+    NetHost_Family_Inet,
+    NetHost_Family_Inet6,
+};
+
+enum NetHost_Type
+{
+    NetHost_Type_Any                = 0,
+    NetHost_Type_Stream,
+    NetHost_Type_Datagram,
+};
+
+enum NetHost_Option
+{
+    NetHost_Option_ReuseAddress     = 0,
+    NetHost_Option_KeepAlive,
+    NetHost_Option_NoDelay,
+    NetHost_Option_Broadcast,
+};
+
+// Message flags
+#define NET_HOST_MSG_PEEK       (1U << 0)
+#define NET_HOST_MSG_WAITALL    (1U << 1)
+
+// Poll events
+#define NET_HOST_POLLIN         (1U << 0)
+#define NET_HOST_POLLOUT        (1U << 1)
+#define NET_HOST_POLLERR        (1U << 2)
+#define NET_HOST_POLLHUP        (1U << 3)
+#define NET_HOST_POLLNVAL       (1U << 4)
+
+/**
+ * \brief An IPv4 or IPv6 address and port
+ */
+struct NetHostAddress
+{
+    // The address family
+    enum NetHost_Family family;
+
+    // The port, in host byte order
+    uint16_t port;
+
+    // The IPv6 scope ID
+    uint32_t scope;
+
+    // The address, in network byte order; IPv4 uses the first four bytes
+    uint8_t address[16];
+};
+
+/**
+ * \brief A host socket to poll
+ */
+struct NetHostPollFd
+{
+    int fd;
+    uint32_t events;
+    uint32_t revents;
+};
+
+/**
+ * \brief A resolved host address
+ */
+struct NetHostAddrInfo
+{
+    enum NetHost_Family family;
+    enum NetHost_Type type;
+    int protocol;
+    struct NetHostAddress address;
+};
+
+int NetHost_Socket(enum NetHost_Family family, enum NetHost_Type type, int protocol);
+int NetHost_Close(int fd);
+int NetHost_Accept(int fd, struct NetHostAddress *address);
+int NetHost_Bind(int fd, const struct NetHostAddress *address);
+int NetHost_Listen(int fd, int backlog);
+int NetHost_Connect(int fd, const struct NetHostAddress *address);
+int NetHost_GetError(int fd);
+int NetHost_SetOption(int fd, enum NetHost_Option option, int value);
+int NetHost_GetOption(int fd, enum NetHost_Option option, int *value);
+int NetHost_Recv(int fd, void *buffer, size_t length, uint32_t flags, struct NetHostAddress *from);
+int NetHost_Send(int fd, const void *buffer, size_t length, uint32_t flags, const struct NetHostAddress *to);
+int NetHost_Poll(struct NetHostPollFd *fds, size_t count);
+
+/**
+ * \brief Resolves a host name
+ *
+ * \param *node
+ *      The host name or address to resolve; can be NULL
+ * \param *service
+ *      The service name or port to resolve; can be NULL
+ * \param family
+ *      The family to limit results to
+ * \param type
+ *      The socket type to limit results to
+ * \param passive
+ *      Whether or not the results will be bound
+ * \param *results
+ *      Where to store the results
+ * \param count
+ *      The maximum number of results to store
+ * \param *canonicalName
+ *      Where to store the canonical name, if not NULL
+ * \param nameLength
+ *      The size of the canonical name buffer
+ *
+ * \return <0
+ *      The negative of an NetHost_ResolveError
+ * \return int
+ *      The number of results stored
+ */
+int NetHost_Resolve(
+    const char *node,
+    const char *service,
+    enum NetHost_Family family,
+    enum NetHost_Type type,
+    bool passive,
+    struct NetHostAddrInfo *results,
+    size_t count,
+    char *canonicalName,
+    size_t nameLength
+);
+
+#ifdef __cplusplus
+}
+#endif
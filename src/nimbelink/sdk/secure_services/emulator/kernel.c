@@ -0,0 +1,87 @@
+/**
+ * \file
+ *
+ * \brief Emulates the Secure firmware's kernel and application services
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <stdint.h>
+
+#include <sys/atomic.h>
+#include <zephyr.h>
+
+#include "posix_board_if.h"
+
+#include "nimbelink/sdk/secure_services/app.h"
+#include "nimbelink/sdk/secure_services/kernel.h"
+#include "nimbelink/sdk/secure_services/emulator/services.h"
+
+// The last errno value, which -- like the Secure firmware's -- is shared by
+// everything
+static atomic_t lastErrno = ATOMIC_INIT(0);
+
+void Emulator_SetErrno(int32_t errnoValue)
+{
+    atomic_set(&lastErrno, errnoValue);
+}
+
+int32_t Emulator_HandleKernel(uint16_t api, void *parameters, uint32_t size)
+{
+    switch ((enum Kernel_Api)api)
+    {
+        // There's no Secure world to run the Non-Secure kernel from, and every
+        // peripheral is already 'accessible'
+        case Kernel_Api_PendSv:
+        case Kernel_Api_PeripheralAccess:
+        case Kernel_Api_MarkImageValid:
+        {
+            return 0;
+        }
+
+        case Kernel_Api_Errno:
+        {
+            if ((parameters == NULL) || (size != sizeof(struct Kernel_ErrnoParameters)))
+            {
+                return -EINVAL;
+            }
+
+            ((struct Kernel_ErrnoParameters *)parameters)->errnoValue = (int32_t)atomic_get(&lastErrno);
+
+            return 0;
+        }
+
+        case Kernel_Api_Reset:
+        {
+            // A reset ends the emulated run
+            posix_exit(0);
+
+            return 0;
+        }
+    }
+
+    return -ENOTSUP;
+}
+
+int32_t Emulator_HandleApp(uint16_t api, void *parameters, uint32_t size)
+{
+    (void)parameters;
+    (void)size;
+
+    // There's no key storage to add keys to
+    switch ((enum App_Api)api)
+    {
+        case App_Api_AddKey:
+        {
+            return -ENOTSUP;
+        }
+    }
+
+    return -ENOTSUP;
+}
@@ -0,0 +1,1401 @@
+/**
+ * \file
+ *
+ * \brief Emulates the Secure firmware's networking service with host sockets
+ *
+ *  Host sockets are always non-blocking, since a blocking host call would
+ *  stall the entire native_posix process. Blocking operations are instead
+ *  retried every CONFIG_SECURE_SERVICES_EMULATOR_POLL_INTERVAL milliseconds,
+ *  which lets the rest of the emulated system run in the meantime.
+ *
+ *  Name resolution is the exception, and does block the process while the
+ *  host resolves the name.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <net/socket.h>
+#include <zephyr.h>
+
+#include "nimbelink/sdk/secure_services/async.h"
+#include "nimbelink/sdk/secure_services/emulator.h"
+#include "nimbelink/sdk/secure_services/net.h"
+#include "nimbelink/sdk/secure_services/emulator/services.h"
+#include "nimbelink/sdk/secure_services/emulator/host/net_host.h"
+
+/**
+ * \brief An emulated socket
+ */
+struct EmulatorSocket
+{
+    // Whether or not this socket is in use
+    bool used;
+
+    // The host socket
+    int host;
+
+    // The socket's type
+    int type;
+
+    // Whether or not the socket is in non-blocking mode
+    bool nonBlocking;
+
+    // How long blocking receives and sends wait, in milliseconds, or -1 to
+    // wait forever
+    int32_t recvTimeout;
+    int32_t sendTimeout;
+
+    // The poll() events last reported in a readiness notification
+    uint32_t reported;
+};
+
+static struct EmulatorSocket emulatorSockets[CONFIG_SECURE_SERVICES_EMULATOR_SOCKET_COUNT];
+
+static K_MUTEX_DEFINE(socketsLock);
+
+// The size of each API's parameter structure
+static const uint32_t parameterSizes[] = {
+    [Net_Api_Socket]        = sizeof(struct Net_SocketParameters),
+    [Net_Api_Close]         = sizeof(struct Net_CloseParameters),
+    [Net_Api_Accept]        = sizeof(struct Net_AcceptParameters),
+    [Net_Api_Bind]          = sizeof(struct Net_BindParameters),
+    [Net_Api_Listen]        = sizeof(struct Net_ListenParameters),
+    [Net_Api_Connect]       = sizeof(struct Net_ConnectParameters),
+    [Net_Api_Poll]          = sizeof(struct Net_PollParameters),
+    [Net_Api_SetSockOpt]    = sizeof(struct Net_SetSockOptParameters),
+    [Net_Api_GetSockOpt]    = sizeof(struct Net_GetSockOptParameters),
+    [Net_Api_Recv]          = sizeof(struct Net_RecvParameters),
+    [Net_Api_RecvFrom]      = sizeof(struct Net_RecvFromParameters),
+    [Net_Api_Send]          = sizeof(struct Net_SendParameters),
+    [Net_Api_SendTo]        = sizeof(struct Net_SendToParameters),
+    [Net_Api_GetAddrInfo]   = sizeof(struct Net_GetAddrInfoParameters),
+    [Net_Api_FreeAddrInfo]  = sizeof(struct Net_FreeAddrInfoParameters),
+    [Net_Api_Fcntl]         = sizeof(struct Net_FcntlParameters),
+};
+
+/**
+ * \brief Gets the errno value for a host socket error
+ *
+ * \param result
+ *      The negative neutral error
+ *
+ * \return int32_t
+ *      The negative errno value
+ */
+static int32_t GetErrno(int result)
+{
+    switch ((enum NetHost_Error)-result)
+    {
+        case NetHost_Error_Again:                   return -EAGAIN;
+        case NetHost_Error_InProgress:              return -EINPROGRESS;
+        case NetHost_Error_Already:                 return -EALREADY;
+        case NetHost_Error_Invalid:                 return -EINVAL;
+        case NetHost_Error_NoMemory:                return -ENOMEM;
+        case NetHost_Error_BadFd:                   return -EBADF;
+        case NetHost_Error_AddressInUse:            return -EADDRINUSE;
+        case NetHost_Error_AddressNotAvailable:     return -EADDRNOTAVAIL;
+        case NetHost_Error_ConnectionRefused:       return -ECONNREFUSED;
+        case NetHost_Error_ConnectionReset:         return -ECONNRESET;
+        case NetHost_Error_ConnectionAborted:       return -ECONNABORTED;
+        case NetHost_Error_NotConnected:            return -ENOTCONN;
+        case NetHost_Error_IsConnected:             return -EISCONN;
+        case NetHost_Error_TimedOut:                return -ETIMEDOUT;
+        case NetHost_Error_HostUnreachable:         return -EHOSTUNREACH;
+        case NetHost_Error_NetworkUnreachable:      return -ENETUNREACH;
+        case NetHost_Error_Pipe:                    return -EPIPE;
+        case NetHost_Error_MessageSize:             return -EMSGSIZE;
+        case NetHost_Error_NotSupported:            return -EOPNOTSUPP;
+        case NetHost_Error_FamilyNotSupported:      return -EAFNOSUPPORT;
+        case NetHost_Error_ProtocolNotSupported:    return -EPROTONOSUPPORT;
+        case NetHost_Error_Interrupted:             return -EINTR;
+        case NetHost_Error_Other:                   break;
+    }
+
+    return -EIO;
+}
+
+/**
+ * \brief Gets an emulated socket
+ *
+ * \param fd
+ *      The socket's descriptor
+ *
+ * \return NULL
+ *      No such socket
+ * \return struct EmulatorSocket *
+ *      The socket
+ */
+static struct EmulatorSocket *GetSocket(int32_t fd)
+{
+    if ((fd < 0) || (fd >= (int32_t)ARRAY_SIZE(emulatorSockets)) || !emulatorSockets[fd].used)
+    {
+        return NULL;
+    }
+
+    return &(emulatorSockets[fd]);
+}
+
+/**
+ * \brief Allocates an emulated socket
+ *
+ * \param host
+ *      The host socket
+ * \param type
+ *      The socket's type
+ *
+ * \return -ENOMEM
+ *      No free sockets
+ * \return int32_t
+ *      The socket's descriptor
+ */
+static int32_t AllocateSocket(int host, int type)
+{
+    int32_t result = -ENOMEM;
+
+    k_mutex_lock(&socketsLock, K_FOREVER);
+
+    for (size_t i = 0; i < ARRAY_SIZE(emulatorSockets); i++)
+    {
+        if (!emulatorSockets[i].used)
+        {
+            emulatorSockets[i] = (struct EmulatorSocket){
+                .used = true,
+                .host = host,
+                .type = type,
+                .nonBlocking = false,
+                .recvTimeout = -1,
+                .sendTimeout = -1,
+                .reported = 0
+            };
+
+            result = (int32_t)i;
+
+            break;
+        }
+    }
+
+    k_mutex_unlock(&socketsLock);
+
+    return result;
+}
+
+/**
+ * \brief Waits before retrying a blocking operation
+ *
+ * \param *socket
+ *      The socket being operated on
+ * \param timeout
+ *      How long the operation may take, in milliseconds, or -1 to wait forever
+ * \param start
+ *      When the operation started, in milliseconds
+ *
+ * \return true
+ *      Retry the operation
+ * \return false
+ *      Operation timed out
+ */
+static bool WaitToRetry(const struct EmulatorSocket *socket, int32_t timeout, int64_t start)
+{
+    if (socket->nonBlocking)
+    {
+        return false;
+    }
+
+    if ((timeout >= 0) && ((k_uptime_get() - start) >= timeout))
+    {
+        return false;
+    }
+
+    k_msleep(CONFIG_SECURE_SERVICES_EMULATOR_POLL_INTERVAL);
+
+    return true;
+}
+
+/**
+ * \brief Converts a Zephyr address to a host address
+ *
+ * \param *addr
+ *      The Zephyr address
+ * \param addrlen
+ *      The Zephyr address's length
+ * \param *address
+ *      Where to store the host address
+ *
+ * \return -EINVAL
+ *      Invalid address
+ * \return -EAFNOSUPPORT
+ *      Unsupported address family
+ * \return 0
+ *      Address converted
+ */
+static int32_t ToHostAddress(const struct sockaddr *addr, uint32_t addrlen, struct NetHostAddress *address)
+{
+    if (addr == NULL)
+    {
+        return -EINVAL;
+    }
+
+    memset(address, 0, sizeof(*address));
+
+    if (addr->sa_family == AF_INET)
+    {
+        const struct sockaddr_in *in = (const struct sockaddr_in *)addr;
+
+        if (addrlen < sizeof(*in))
+        {
+            return -EINVAL;
+        }
+
+        address->family = NetHost_Family_Inet;
+        address->port = ntohs(in->sin_port);
+        memcpy(address->address, &(in->sin_addr), sizeof(in->sin_addr));
+
+        return 0;
+    }
+
+    if (addr->sa_family == AF_INET6)
+    {
+        const struct sockaddr_in6 *in6 = (const struct sockaddr_in6 *)addr;
+
+        if (addrlen < sizeof(*in6))
+        {
+            return -EINVAL;
+        }
+
+        address->family = NetHost_Family_Inet6;
+        address->port = ntohs(in6->sin6_port);
+        address->scope = in6->sin6_scope_id;
+        memcpy(address->address, &(in6->sin6_addr), sizeof(in6->sin6_addr));
+
+        return 0;
+    }
+
+    return -EAFNOSUPPORT;
+}
+
+/**
+ * \brief Converts a host address to a Zephyr address
+ *
+ * \param *address
+ *      The host address
+ * \param *addr
+ *      Where to store the Zephyr address
+ * \param *addrlen
+ *      The Zephyr address's capacity, updated with its full length
+ *
+ * \return none
+ */
+static void FromHostAddress(const struct NetHostAddress *address, struct sockaddr *addr, uint32_t *addrlen)
+{
+    struct sockaddr storage;
+    uint32_t length;
+
+    memset(&storage, 0, sizeof(storage));
+
+    if (address->family == NetHost_Family_Inet6)
+    {
+        struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&storage;
+
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(address->port);
+        in6->sin6_scope_id = address->scope;
+        memcpy(&(in6->sin6_addr), address->address, sizeof(in6->sin6_addr));
+
+        length = sizeof(*in6);
+    }
+    else
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)&storage;
+
+        in->sin_family = AF_INET;
+        in->sin_port = htons(address->port);
+        memcpy(&(in->sin_addr), address->address, sizeof(in->sin_addr));
+
+        length = sizeof(*in);
+    }
+
+    // Give as much of the address as fits, but report its full length
+    memcpy(addr, &storage, MIN(*addrlen, length));
+
+    *addrlen = length;
+}
+
+/**
+ * \brief Converts Zephyr poll() events to host ones
+ *
+ * \param events
+ *      The Zephyr events
+ *
+ * \return uint32_t
+ *      The host events
+ */
+static uint32_t ToHostEvents(int32_t events)
+{
+    uint32_t hostEvents = 0;
+
+    if ((events & POLLIN) != 0)
+    {
+        hostEvents |= NET_HOST_POLLIN;
+    }
+
+    if ((events & POLLOUT) != 0)
+    {
+        hostEvents |= NET_HOST_POLLOUT;
+    }
+
+    return hostEvents;
+}
+
+/**
+ * \brief Converts host poll() events to Zephyr ones
+ *
+ * \param hostEvents
+ *      The host events
+ *
+ * \return int32_t
+ *      The Zephyr events
+ */
+static int32_t FromHostEvents(uint32_t hostEvents)
+{
+    int32_t events = 0;
+
+    if ((hostEvents & NET_HOST_POLLIN) != 0)
+    {
+        events |= POLLIN;
+    }
+
+    if ((hostEvents & NET_HOST_POLLOUT) != 0)
+    {
+        events |= POLLOUT;
+    }
+
+    if ((hostEvents & NET_HOST_POLLERR) != 0)
+    {
+        events |= POLLERR;
+    }
+
+    if ((hostEvents & NET_HOST_POLLHUP) != 0)
+    {
+        events |= POLLHUP;
+    }
+
+    if ((hostEvents & NET_HOST_POLLNVAL) != 0)
+    {
+        events |= POLLNVAL;
+    }
+
+    return events;
+}
+
+static int32_t Socket(struct Net_SocketParameters *parameters)
+{
+    enum NetHost_Family family;
+    enum NetHost_Type type;
+
+    switch (parameters->family)
+    {
+        case AF_INET:   family = NetHost_Family_Inet;   break;
+        case AF_INET6:  family = NetHost_Family_Inet6;  break;
+        default:        return -EAFNOSUPPORT;
+    }
+
+    switch (parameters->type)
+    {
+        case SOCK_STREAM:   type = NetHost_Type_Stream;     break;
+        case SOCK_DGRAM:    type = NetHost_Type_Datagram;   break;
+        default:            return -EPROTOTYPE;
+    }
+
+    // There's no TLS to offload to
+    if ((parameters->proto != 0) && (parameters->proto != IPPROTO_TCP) && (parameters->proto != IPPROTO_UDP))
+    {
+        return -EPROTONOSUPPORT;
+    }
+
+    int host = NetHost_Socket(family, type, parameters->proto);
+
+    if (host < 0)
+    {
+        return GetErrno(host);
+    }
+
+    int32_t fd = AllocateSocket(host, parameters->type);
+
+    if (fd < 0)
+    {
+        NetHost_Close(host);
+    }
+
+    return fd;
+}
+
+static int32_t Close(struct Net_CloseParameters *parameters)
+{
+    k_mutex_lock(&socketsLock, K_FOREVER);
+
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket != NULL)
+    {
+        socket->used = false;
+
+        NetHost_Close(socket->host);
+    }
+
+    k_mutex_unlock(&socketsLock);
+
+    return (socket != NULL) ? 0 : -EBADF;
+}
+
+static int32_t Accept(struct Net_AcceptParameters *parameters)
+{
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    struct NetHostAddress address;
+
+    int64_t start = k_uptime_get();
+
+    int host;
+
+    while (true)
+    {
+        host = NetHost_Accept(socket->host, &address);
+
+        if ((host != -NetHost_Error_Again) || !WaitToRetry(socket, socket->recvTimeout, start))
+        {
+            break;
+        }
+    }
+
+    if (host < 0)
+    {
+        return GetErrno(host);
+    }
+
+    int32_t fd = AllocateSocket(host, SOCK_STREAM);
+
+    if (fd < 0)
+    {
+        NetHost_Close(host);
+
+        return fd;
+    }
+
+    if ((parameters->addr != NULL) && (parameters->addrlen != NULL))
+    {
+        FromHostAddress(&address, parameters->addr, parameters->addrlen);
+    }
+
+    return fd;
+}
+
+static int32_t Bind(struct Net_BindParameters *parameters)
+{
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    struct NetHostAddress address;
+
+    int32_t result = ToHostAddress(parameters->addr, parameters->addrlen, &address);
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    result = NetHost_Bind(socket->host, &address);
+
+    return (result < 0) ? GetErrno(result) : 0;
+}
+
+static int32_t Listen(struct Net_ListenParameters *parameters)
+{
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    int result = NetHost_Listen(socket->host, parameters->backlog);
+
+    return (result < 0) ? GetErrno(result) : 0;
+}
+
+static int32_t Connect(struct Net_ConnectParameters *parameters)
+{
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    struct NetHostAddress address;
+
+    int32_t result = ToHostAddress(parameters->addr, parameters->addrlen, &address);
+
+    if (result != 0)
+    {
+        return result;
+    }
+
+    result = NetHost_Connect(socket->host, &address);
+
+    // If this is finishing up in the background, either let a non-blocking
+    // caller know or wait for it to finish
+    if ((result != -NetHost_Error_InProgress) || socket->nonBlocking)
+    {
+        return (result < 0) ? GetErrno(result) : 0;
+    }
+
+    int64_t start = k_uptime_get();
+
+    while (true)
+    {
+        struct NetHostPollFd fd = {
+            .fd = socket->host,
+            .events = NET_HOST_POLLOUT
+        };
+
+        result = NetHost_Poll(&fd, 1);
+
+        if (result < 0)
+        {
+            return GetErrno(result);
+        }
+
+        if (fd.revents != 0)
+        {
+            break;
+        }
+
+        if (!WaitToRetry(socket, socket->sendTimeout, start))
+        {
+            return -ETIMEDOUT;
+        }
+    }
+
+    // The connection's outcome is in its pending error
+    result = NetHost_GetError(socket->host);
+
+    if (result < 0)
+    {
+        return GetErrno(result);
+    }
+
+    return (result > 0) ? GetErrno(-result) : 0;
+}
+
+static int32_t Poll(struct Net_PollParameters *parameters)
+{
+    struct NetHostPollFd fds[CONFIG_SECURE_SERVICES_EMULATOR_SOCKET_COUNT];
+
+    if ((parameters->nfds < 0) || (parameters->nfds > (int32_t)ARRAY_SIZE(fds)))
+    {
+        return -EINVAL;
+    }
+
+    if ((parameters->fds == NULL) && (parameters->nfds > 0))
+    {
+        return -EINVAL;
+    }
+
+    int64_t start = k_uptime_get();
+
+    while (true)
+    {
+        size_t count = 0;
+
+        int32_t ready = 0;
+
+        // Poll everything that's actually a socket
+        for (int32_t i = 0; i < parameters->nfds; i++)
+        {
+            struct EmulatorSocket *socket = GetSocket(parameters->fds[i].fd);
+
+            parameters->fds[i].revents = 0;
+
+            if (socket == NULL)
+            {
+                parameters->fds[i].revents = POLLNVAL;
+                ready++;
+
+                continue;
+            }
+
+            fds[count].fd = socket->host;
+            fds[count].events = ToHostEvents(parameters->fds[i].events);
+            fds[count].revents = 0;
+
+            count++;
+        }
+
+        if (count > 0)
+        {
+            int result = NetHost_Poll(fds, count);
+
+            if (result < 0)
+            {
+                return GetErrno(result);
+            }
+
+            count = 0;
+
+            for (int32_t i = 0; i < parameters->nfds; i++)
+            {
+                if (parameters->fds[i].revents != 0)
+                {
+                    continue;
+                }
+
+                parameters->fds[i].revents = FromHostEvents(fds[count].revents);
+
+                if (parameters->fds[i].revents != 0)
+                {
+                    ready++;
+                }
+
+                count++;
+            }
+        }
+
+        if (ready > 0)
+        {
+            return ready;
+        }
+
+        if ((parameters->timeout >= 0) && ((k_uptime_get() - start) >= parameters->timeout))
+        {
+            return 0;
+        }
+
+        k_msleep(CONFIG_SECURE_SERVICES_EMULATOR_POLL_INTERVAL);
+    }
+}
+
+/**
+ * \brief Gets a host socket option
+ *
+ * \param level
+ *      The option's level
+ * \param optname
+ *      The option's name
+ * \param *option
+ *      Where to store the host option
+ *
+ * \return true
+ *      Option converted
+ * \return false
+ *      Option not supported
+ */
+static bool GetHostOption(int32_t level, int32_t optname, enum NetHost_Option *option)
+{
+    if (level == SOL_SOCKET)
+    {
+        switch (optname)
+        {
+            case SO_REUSEADDR:
+                *option = NetHost_Option_ReuseAddress;
+                return true;
+
+        #ifdef SO_KEEPALIVE
+            case SO_KEEPALIVE:
+                *option = NetHost_Option_KeepAlive;
+                return true;
+        #endif
+
+        #ifdef SO_BROADCAST
+            case SO_BROADCAST:
+                *option = NetHost_Option_Broadcast;
+                return true;
+        #endif
+        }
+    }
+    else if ((level == IPPROTO_TCP) && (optname == TCP_NODELAY))
+    {
+        *option = NetHost_Option_NoDelay;
+        return true;
+    }
+
+    return false;
+}
+
+static int32_t SetSockOpt(struct Net_SetSockOptParameters *parameters)
+{
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    // Blocking operations are emulated, so their timeouts are too
+    if ((parameters->level == SOL_SOCKET) &&
+        ((parameters->optname == SO_RCVTIMEO) || (parameters->optname == SO_SNDTIMEO)))
+    {
+        if ((parameters->optval == NULL) || (parameters->optlen < sizeof(struct timeval)))
+        {
+            return -EINVAL;
+        }
+
+        const struct timeval *value = (const struct timeval *)parameters->optval;
+
+        int32_t timeout = (int32_t)((value->tv_sec * MSEC_PER_SEC) + (value->tv_usec / USEC_PER_MSEC));
+
+        // A zero timeout waits forever
+        if (timeout == 0)
+        {
+            timeout = -1;
+        }
+
+        if (parameters->optname == SO_RCVTIMEO)
+        {
+            socket->recvTimeout = timeout;
+        }
+        else
+        {
+            socket->sendTimeout = timeout;
+        }
+
+        return 0;
+    }
+
+    enum NetHost_Option option;
+
+    if (!GetHostOption(parameters->level, parameters->optname, &option))
+    {
+        return -ENOPROTOOPT;
+    }
+
+    if ((parameters->optval == NULL) || (parameters->optlen < sizeof(int)))
+    {
+        return -EINVAL;
+    }
+
+    int result = NetHost_SetOption(socket->host, option, *(const int *)parameters->optval);
+
+    return (result < 0) ? GetErrno(result) : 0;
+}
+
+static int32_t GetSockOpt(struct Net_GetSockOptParameters *parameters)
+{
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    if ((parameters->optval == NULL) || (parameters->optlen == NULL) || (*parameters->optlen < sizeof(int)))
+    {
+        return -EINVAL;
+    }
+
+    int *value = (int *)parameters->optval;
+
+    if (parameters->level == SOL_SOCKET)
+    {
+        switch (parameters->optname)
+        {
+            case SO_ERROR:
+            {
+                int result = NetHost_GetError(socket->host);
+
+                if (result < 0)
+                {
+                    return GetErrno(result);
+                }
+
+                *value = (result != 0) ? -GetErrno(-result) : 0;
+                *parameters->optlen = sizeof(int);
+
+                return 0;
+            }
+
+            case SO_TYPE:
+            {
+                *value = socket->type;
+                *parameters->optlen = sizeof(int);
+
+                return 0;
+            }
+        }
+    }
+
+    enum NetHost_Option option;
+
+    if (!GetHostOption(parameters->level, parameters->optname, &option))
+    {
+        return -ENOPROTOOPT;
+    }
+
+    int result = NetHost_GetOption(socket->host, option, value);
+
+    if (result < 0)
+    {
+        return GetErrno(result);
+    }
+
+    *parameters->optlen = sizeof(int);
+
+    return 0;
+}
+
+/**
+ * \brief Receives data on an emulated socket
+ *
+ * \param fd
+ *      The socket's descriptor
+ * \param *buf
+ *      Where to store the data
+ * \param len
+ *      The maximum amount of data to receive
+ * \param flags
+ *      Zephyr MSG_* flags
+ * \param *from
+ *      Where to store the sender's address; can be NULL
+ * \param *fromlen
+ *      The sender's address's capacity, updated with its length; can be NULL
+ *
+ * \return <0
+ *      The negative errno value
+ * \return int32_t
+ *      The amount of data received
+ */
+static int32_t Receive(int32_t fd, void *buf, size_t len, int32_t flags, struct sockaddr *from, uint32_t *fromlen)
+{
+    struct EmulatorSocket *socket = GetSocket(fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    if ((buf == NULL) && (len > 0))
+    {
+        return -EINVAL;
+    }
+
+    uint32_t hostFlags = ((flags & MSG_PEEK) != 0) ? NET_HOST_MSG_PEEK : 0;
+
+    bool dontWait = ((flags & MSG_DONTWAIT) != 0);
+
+    // Only a stream can have its data pieced together
+    bool waitAll = ((flags & MSG_WAITALL) != 0) && ((flags & MSG_PEEK) == 0) && (socket->type == SOCK_STREAM);
+
+    struct NetHostAddress address;
+
+    int64_t start = k_uptime_get();
+
+    size_t count = 0;
+
+    while (true)
+    {
+        int result = NetHost_Recv(socket->host, &(((uint8_t *)buf)[count]), len - count, hostFlags, &address);
+
+        if (result > 0)
+        {
+            count += result;
+
+            if (!waitAll || (count >= len))
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        // If the peer is done sending, so are we
+        if (result == 0)
+        {
+            break;
+        }
+
+        if (result != -NetHost_Error_Again)
+        {
+            if (count > 0)
+            {
+                break;
+            }
+
+            return GetErrno(result);
+        }
+
+        if (dontWait || !WaitToRetry(socket, socket->recvTimeout, start))
+        {
+            if (count > 0)
+            {
+                break;
+            }
+
+            return -EAGAIN;
+        }
+    }
+
+    if ((from != NULL) && (fromlen != NULL))
+    {
+        FromHostAddress(&address, from, fromlen);
+    }
+
+    return (int32_t)count;
+}
+
+/**
+ * \brief Sends data on an emulated socket
+ *
+ * \param fd
+ *      The socket's descriptor
+ * \param *buf
+ *      The data to send
+ * \param len
+ *      The amount of data to send
+ * \param flags
+ *      Zephyr MSG_* flags
+ * \param *to
+ *      The address to send to; can be NULL
+ * \param tolen
+ *      The length of the address
+ *
+ * \return <0
+ *      The negative errno value
+ * \return int32_t
+ *      The amount of data sent
+ */
+static int32_t Transmit(int32_t fd, const void *buf, size_t len, int32_t flags, const struct sockaddr *to, uint32_t tolen)
+{
+    struct EmulatorSocket *socket = GetSocket(fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    if ((buf == NULL) && (len > 0))
+    {
+        return -EINVAL;
+    }
+
+    struct NetHostAddress address;
+
+    if (to != NULL)
+    {
+        int32_t result = ToHostAddress(to, tolen, &address);
+
+        if (result != 0)
+        {
+            return result;
+        }
+    }
+
+    bool dontWait = ((flags & MSG_DONTWAIT) != 0);
+
+    int64_t start = k_uptime_get();
+
+    size_t count = 0;
+
+    while (true)
+    {
+        int result = NetHost_Send(
+            socket->host,
+            &(((const uint8_t *)buf)[count]),
+            len - count,
+            0,
+            (to != NULL) ? &address : NULL
+        );
+
+        if (result >= 0)
+        {
+            count += result;
+
+            // A blocking stream sends everything before returning
+            if ((socket->type != SOCK_STREAM) || socket->nonBlocking || dontWait || (count >= len))
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        if (result != -NetHost_Error_Again)
+        {
+            if (count > 0)
+            {
+                break;
+            }
+
+            return GetErrno(result);
+        }
+
+        if (dontWait || !WaitToRetry(socket, socket->sendTimeout, start))
+        {
+            if (count > 0)
+            {
+                break;
+            }
+
+            return -EAGAIN;
+        }
+    }
+
+    return (int32_t)count;
+}
+
+/**
+ * \brief Gets the getaddrinfo() result for a host resolution error
+ *
+ * \param result
+ *      The negative neutral resolution error
+ *
+ * \return int32_t
+ *      The getaddrinfo() result
+ */
+static int32_t GetResolveResult(int result)
+{
+    switch ((enum NetHost_ResolveError)-result)
+    {
+        case NetHost_ResolveError_Again:        return DNS_EAI_AGAIN;
+        case NetHost_ResolveError_NoName:       return DNS_EAI_NONAME;
+        case NetHost_ResolveError_Family:       return DNS_EAI_FAMILY;
+        case NetHost_ResolveError_SocketType:   return DNS_EAI_SOCKTYPE;
+        case NetHost_ResolveError_Service:      return DNS_EAI_SERVICE;
+        case NetHost_ResolveError_Memory:       return DNS_EAI_MEMORY;
+        case NetHost_ResolveError_Fail:         break;
+    }
+
+    return DNS_EAI_FAIL;
+}
+
+static int32_t GetAddrInfo(struct Net_GetAddrInfoParameters *parameters)
+{
+    struct NetHostAddrInfo results[4];
+
+    if ((parameters->res == NULL) || (parameters->reslen == 0))
+    {
+        return DNS_EAI_FAIL;
+    }
+
+    enum NetHost_Family family = NetHost_Family_Unspecified;
+    enum NetHost_Type type = NetHost_Type_Any;
+    bool passive = false;
+    bool canonical = false;
+
+    const struct nl_addrinfo *hints = parameters->hints;
+
+    if (hints != NULL)
+    {
+        switch (hints->ai_family)
+        {
+            case AF_UNSPEC: family = NetHost_Family_Unspecified;    break;
+            case AF_INET:   family = NetHost_Family_Inet;           break;
+            case AF_INET6:  family = NetHost_Family_Inet6;          break;
+            default:        return DNS_EAI_FAMILY;
+        }
+
+        switch (hints->ai_socktype)
+        {
+            case 0:             type = NetHost_Type_Any;        break;
+            case SOCK_STREAM:   type = NetHost_Type_Stream;     break;
+            case SOCK_DGRAM:    type = NetHost_Type_Datagram;   break;
+            default:            return DNS_EAI_SOCKTYPE;
+        }
+
+        passive = ((hints->ai_flags & AI_PASSIVE) != 0);
+        canonical = ((hints->ai_flags & AI_CANONNAME) != 0);
+    }
+
+    struct nl_addrinfo *first = parameters->res[0];
+
+    int count = NetHost_Resolve(
+        parameters->node,
+        parameters->service,
+        family,
+        type,
+        passive,
+        results,
+        MIN(parameters->reslen, ARRAY_SIZE(results)),
+        (canonical && (first->ai_canonname != NULL)) ? first->ai_canonname : NULL,
+        NET_AI_CANONNAME_MAX_LENGTH + 1
+    );
+
+    if (count < 0)
+    {
+        return GetResolveResult(count);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        struct nl_addrinfo *info = parameters->res[i];
+
+        info->ai_flags = (hints != NULL) ? hints->ai_flags : 0;
+        info->ai_family = (results[i].family == NetHost_Family_Inet6) ? AF_INET6 : AF_INET;
+        info->ai_socktype = (results[i].type == NetHost_Type_Datagram) ? SOCK_DGRAM : SOCK_STREAM;
+        info->ai_protocol = results[i].protocol;
+
+        uint32_t length = sizeof(struct sockaddr);
+
+        FromHostAddress(&(results[i].address), info->ai_addr, &length);
+
+        info->ai_addrlen = length;
+
+        // Only the first result gets the canonical name
+        if ((i > 0) || !canonical)
+        {
+            if (info->ai_canonname != NULL)
+            {
+                info->ai_canonname[0] = '\0';
+            }
+        }
+
+        info->ai_next = ((i + 1) < count) ? parameters->res[i + 1] : NULL;
+    }
+
+    return 0;
+}
+
+static int32_t Fcntl(struct Net_FcntlParameters *parameters)
+{
+    struct EmulatorSocket *socket = GetSocket(parameters->fd);
+
+    if (socket == NULL)
+    {
+        return -EBADF;
+    }
+
+    switch (parameters->cmd)
+    {
+        case F_GETFL:
+        {
+            return socket->nonBlocking ? O_NONBLOCK : 0;
+        }
+
+        case F_SETFL:
+        {
+            socket->nonBlocking = ((parameters->args & O_NONBLOCK) != 0);
+
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+
+int32_t Emulator_HandleNet(uint16_t api, void *parameters, uint32_t size)
+{
+    if ((api >= ARRAY_SIZE(parameterSizes)) || (parameters == NULL))
+    {
+        return -EINVAL;
+    }
+
+    uint32_t expected = parameterSizes[api];
+
+    // The parameters might be followed by room for an errno value
+    if ((size != expected) && (size != (expected + sizeof(uint32_t))))
+    {
+        return -EINVAL;
+    }
+
+    int32_t result;
+
+    switch ((enum Net_Api)api)
+    {
+        case Net_Api_Socket:
+            result = Socket(parameters);
+            break;
+
+        case Net_Api_Close:
+            result = Close(parameters);
+            break;
+
+        case Net_Api_Accept:
+            result = Accept(parameters);
+            break;
+
+        case Net_Api_Bind:
+            result = Bind(parameters);
+            break;
+
+        case Net_Api_Listen:
+            result = Listen(parameters);
+            break;
+
+        case Net_Api_Connect:
+            result = Connect(parameters);
+            break;
+
+        case Net_Api_Poll:
+            result = Poll(parameters);
+            break;
+
+        case Net_Api_SetSockOpt:
+            result = SetSockOpt(parameters);
+            break;
+
+        case Net_Api_GetSockOpt:
+            result = GetSockOpt(parameters);
+            break;
+
+        case Net_Api_Recv:
+        {
+            struct Net_RecvParameters *recv = parameters;
+
+            result = Receive(recv->fd, recv->buf, recv->max_len, recv->flags, NULL, NULL);
+            break;
+        }
+
+        case Net_Api_RecvFrom:
+        {
+            struct Net_RecvFromParameters *recv = parameters;
+
+            // The Secure firmware only has a signed 16-bit length, so a
+            // length that didn't fit -- and wrapped negative -- isn't valid,
+            // rather than being a larger unsigned length
+            if (recv->len < 0)
+            {
+                result = -EINVAL;
+                break;
+            }
+
+            result = Receive(recv->fd, recv->buf, recv->len, recv->flags, recv->from, recv->fromlen);
+            break;
+        }
+
+        case Net_Api_Send:
+        {
+            struct Net_SendParameters *send = parameters;
+
+            result = Transmit(send->fd, send->buf, send->len, send->flags, NULL, 0);
+            break;
+        }
+
+        case Net_Api_SendTo:
+        {
+            struct Net_SendToParameters *send = parameters;
+
+            result = Transmit(send->fd, send->buf, send->len, send->flags, send->to, send->tolen);
+            break;
+        }
+
+        // Name resolution reports its own results rather than using errno
+        case Net_Api_GetAddrInfo:
+            return GetAddrInfo(parameters);
+
+        // The results are in Non-Secure memory, so there's nothing to free
+        case Net_Api_FreeAddrInfo:
+            return 0;
+
+        case Net_Api_Fcntl:
+            result = Fcntl(parameters);
+            break;
+
+        default:
+            return -ENOTSUP;
+    }
+
+    if (result >= 0)
+    {
+        return result;
+    }
+
+    // Fail the way the BSD library does, with the error in errno
+    Emulator_SetErrno(-result);
+
+    if (size > expected)
+    {
+        int32_t errnoValue = -result;
+
+        memcpy(&(((uint8_t *)parameters)[expected]), &errnoValue, sizeof(errnoValue));
+    }
+
+    return -1;
+}
+
+#if CONFIG_SECURE_SERVICES_EMULATOR_READINESS
+/**
+ * \brief Sends readiness notifications for sockets whose events changed
+ *
+ * \param none
+ *
+ * \return none
+ */
+static void MonitorReadiness(void)
+{
+    while (true)
+    {
+        k_msleep(CONFIG_SECURE_SERVICES_EMULATOR_POLL_INTERVAL);
+
+        k_mutex_lock(&socketsLock, K_FOREVER);
+
+        for (size_t i = 0; i < ARRAY_SIZE(emulatorSockets); i++)
+        {
+            struct EmulatorSocket *socket = &(emulatorSockets[i]);
+
+            if (!socket->used)
+            {
+                continue;
+            }
+
+            struct NetHostPollFd fd = {
+                .fd = socket->host,
+                .events = NET_HOST_POLLIN | NET_HOST_POLLOUT
+            };
+
+            if (NetHost_Poll(&fd, 1) < 0)
+            {
+                continue;
+            }
+
+            if (fd.revents == socket->reported)
+            {
+                continue;
+            }
+
+            struct Net_ReadinessEvent event = {
+                .fd = (int32_t)i,
+                .revents = FromHostEvents(fd.revents)
+            };
+
+            // If the notification was dropped, try again next time
+            if (Emulator_SendAsync(Async_Event_NetReadiness, &event, sizeof(event)) == 0)
+            {
+                socket->reported = fd.revents;
+            }
+        }
+
+        k_mutex_unlock(&socketsLock);
+    }
+}
+
+K_THREAD_DEFINE(
+    emulator_readiness_thread,
+    CONFIG_SECURE_SERVICES_EMULATOR_STACK_SIZE,
+    MonitorReadiness,
+    NULL,
+    NULL,
+    NULL,
+    CONFIG_SECURE_SERVICES_EMULATOR_THREAD_PRIORITY,
+    0,
+    0
+);
+#endif
@@ -0,0 +1,56 @@
+/**
+ * \file
+ *
+ * \brief The emulated Secure firmware's services
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Handles an emulated service's request
+ *
+ *  These run on the emulator's worker thread for the request's channel, and
+ *  may block as long as they need to.
+ *
+ * \param api
+ *      The service API
+ * \param *parameters
+ *      The request's parameters, which are updated with the response
+ * \param size
+ *      The size of the parameters
+ *
+ * \return int32_t
+ *      The result of the request
+ */
+int32_t Emulator_HandleKernel(uint16_t api, void *parameters, uint32_t size);
+int32_t Emulator_HandleAt(uint16_t api, void *parameters, uint32_t size);
+int32_t Emulator_HandleApp(uint16_t api, void *parameters, uint32_t size);
+int32_t Emulator_HandleNet(uint16_t api, void *parameters, uint32_t size);
+
+/**
+ * \brief Sets the errno value the emulated Kernel service reports
+ *
+ * \param errnoValue
+ *      The errno value
+ *
+ * \return none
+ */
+void Emulator_SetErrno(int32_t errnoValue);
+
+#ifdef __cplusplus
+}
+#endif
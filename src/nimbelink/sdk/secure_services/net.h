@@ -19,7 +19,9 @@
  */
 #pragma once
 
+#include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <net/socket.h>
 
@@ -196,6 +198,92 @@ struct Net_FcntlParameters
     int32_t args;
 };
 
+/**
+ * \brief The largest parameter structure used by the networking APIs
+ */
+#define NET_PARAMETERS_MAX_SIZE     sizeof(struct Net_SendToParameters)
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+/**
+ * \brief An errno value the Secure firmware hasn't filled in
+ */
+#define NET_ERRNO_UNSET             INT32_MIN
+
+/**
+ * \brief Calls a networking API, with errno returned in the response
+ *
+ *  The extended networking parameters are any networking API's parameter
+ *  structure followed directly by a 32-bit errno value, which the Secure
+ *  firmware fills in when the call fails. This saves a separate Kernel_Errno()
+ *  call for failing operations.
+ *
+ *  No stack firmware ABI defines the extended parameters yet, so this is only
+ *  available with the emulator's experimental extensions.
+ *
+ * \param api
+ *      The networking API
+ * \param *parameters
+ *      The API's parameter structure
+ * \param size
+ *      The size of the API's parameter structure
+ * \param *errnoValue
+ *      Where to store the errno value from the response
+ *
+ * \return -EINVAL
+ *      Unsupported parameter structure size, with *errnoValue set to EINVAL
+ * \return int32_t
+ *      The result of the request
+ */
+static inline int32_t Net_CallWithErrno(uint16_t api, void *parameters, uint32_t size, int32_t *errnoValue)
+{
+    uint32_t extended[(NET_PARAMETERS_MAX_SIZE / sizeof(uint32_t)) + 1];
+
+    *errnoValue = NET_ERRNO_UNSET;
+
+    // The errno value needs to land on a word boundary right after the
+    // parameters
+    if (((size % sizeof(uint32_t)) != 0) || (size > NET_PARAMETERS_MAX_SIZE))
+    {
+        *errnoValue = EINVAL;
+
+        return -EINVAL;
+    }
+
+    memcpy(extended, parameters, size);
+
+    extended[size / sizeof(uint32_t)] = (uint32_t)NET_ERRNO_UNSET;
+
+    int32_t result = CallSecureService(SecureService_Net, api, extended, size + sizeof(uint32_t));
+
+    // Pass back anything the response updated
+    memcpy(parameters, extended, size);
+
+    *errnoValue = (int32_t)extended[size / sizeof(uint32_t)];
+
+    return result;
+}
+#endif
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+/**
+ * \brief The contents of a socket readiness notification
+ *
+ *  The emulator sends one of these as an Async_Event_NetReadiness message
+ *  whenever a socket's poll() events might have changed. They are only hints:
+ *  the socket's actual state should still be checked with Net_Poll().
+ */
+struct Net_ReadinessEvent
+{
+    // The socket whose readiness changed
+    int32_t fd;
+
+    // The socket's new poll() events
+    int32_t revents;
+};
+
+typedef void (*Net_ReadinessCallback)(int32_t fd, int32_t revents);
+#endif
+
 static inline int32_t Net_Socket(int32_t family, int32_t type, int32_t proto)
 {
     struct Net_SocketParameters parameters = {
@@ -381,6 +469,26 @@ static inline int32_t Net_Fcntl(int32_t fd, int32_t cmd, int32_t args)
     return CallSecureService(SecureService_Net, Net_Api_Fcntl, &parameters, sizeof(parameters));
 }
 
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+/**
+ * \brief Subscribes to socket readiness notifications
+ *
+ *  This registers the Async_Event_NetReadiness handler, so only one callback
+ *  can be subscribed.
+ *
+ * \param callback
+ *      The callback to invoke when a socket's readiness changes
+ *
+ * \return -EINVAL
+ *      Invalid callback
+ * \return -EALREADY
+ *      A callback is already subscribed
+ * \return 0
+ *      Callback subscribed
+ */
+int32_t Net_SubscribeReadiness(Net_ReadinessCallback callback);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -431,6 +539,19 @@ namespace NimbeLink::Sdk::SecureServices::Net
     using GetAddrInfoParameters     = Net_GetAddrInfoParameters;
     using FreeAddrInfoParameters    = Net_FreeAddrInfoParameters;
     using FcntlParameters           = Net_FcntlParameters;
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+    using ReadinessEvent            = Net_ReadinessEvent;
+    using ReadinessCallback         = Net_ReadinessCallback;
+#endif
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+    static constexpr const int32_t ErrnoUnset = NET_ERRNO_UNSET;
+
+    static inline int32_t CallWithErrno(Api api, void *parameters, uint32_t size, int32_t *errnoValue)
+    {
+        return Net_CallWithErrno(api, parameters, size, errnoValue);
+    }
+#endif
 
     template <typename... Args>
     static inline int32_t Socket(Args&&... args)
@@ -528,5 +649,12 @@ namespace NimbeLink::Sdk::SecureServices::Net
         return Net_Fcntl(std::forward<Args>(args)...);
     }
 
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+    static inline int32_t SubscribeReadiness(ReadinessCallback callback)
+    {
+        return Net_SubscribeReadiness(callback);
+    }
+#endif
+
 }
 #endif
@@ -0,0 +1,165 @@
+/**
+ * \file
+ *
+ * \brief Dispatches asynchronous secure service messages
+ *
+ *  Each event has a slot in the dispatch table for a single handler, which
+ *  the asynchronous message thread looks up for every message it drains.
+ *
+ *  The transport only gives us asynchronous messages by copying them into a
+ *  full-sized Async_Parameters structure, so that copy stays. Buffers in the
+ *  pool are then sized to each message, so a short URC only takes up a few
+ *  bytes for as long as it's being held.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr.h>
+
+#include "nimbelink/sdk/secure_services/async.h"
+#include "nimbelink/sdk/secure_services/zephyr/async.h"
+
+/**
+ * \brief An asynchronous event's handler
+ */
+struct AsyncHandler
+{
+    // The handler
+    Async_Handler handler;
+
+    // A context to pass to the handler
+    void *context;
+};
+
+// The handlers for each event
+static struct AsyncHandler asyncHandlers[Async_Event_Count];
+
+// The pool asynchronous message buffers are allocated from
+static K_HEAP_DEFINE(asyncPool, CONFIG_SECURE_SERVICES_ASYNC_POOL_SIZE);
+
+int32_t Async_RegisterHandler(uint32_t event, Async_Handler handler, void *context)
+{
+    if ((event >= Async_Event_Count) || (handler == NULL))
+    {
+        return -EINVAL;
+    }
+
+    int32_t result = -EALREADY;
+
+    uint32_t key = irq_lock();
+
+    if (asyncHandlers[event].handler == NULL)
+    {
+        asyncHandlers[event] = (struct AsyncHandler){
+            .handler = handler,
+            .context = context
+        };
+
+        result = 0;
+    }
+
+    irq_unlock(key);
+
+    return result;
+}
+
+int32_t Async_UnregisterHandler(uint32_t event, Async_Handler handler)
+{
+    if (event >= Async_Event_Count)
+    {
+        return -EINVAL;
+    }
+
+    int32_t result = -ENOENT;
+
+    uint32_t key = irq_lock();
+
+    if ((handler != NULL) && (asyncHandlers[event].handler == handler))
+    {
+        asyncHandlers[event] = (struct AsyncHandler){0};
+
+        result = 0;
+    }
+
+    irq_unlock(key);
+
+    return result;
+}
+
+void DispatchAsyncEvent(uint32_t event, const void *data, size_t size)
+{
+    if (event >= Async_Event_Count)
+    {
+        return;
+    }
+
+    // Grab the handler and its context together
+    uint32_t key = irq_lock();
+
+    struct AsyncHandler handler = asyncHandlers[event];
+
+    irq_unlock(key);
+
+    if (handler.handler != NULL)
+    {
+        handler.handler(event, data, size, handler.context);
+    }
+}
+
+struct Async_Buffer *AllocateAsyncBuffer(uint32_t event, const void *data, size_t length)
+{
+    // Never wait for room, since the asynchronous message thread can't afford
+    // to block
+    struct Async_Buffer *buffer = k_heap_alloc(&asyncPool, sizeof(*buffer) + length, K_NO_WAIT);
+
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    atomic_set(&(buffer->references), 1);
+
+    buffer->event = event;
+    buffer->length = length;
+
+    if ((data != NULL) && (length > 0))
+    {
+        memcpy(buffer->data, data, length);
+    }
+
+    return buffer;
+}
+
+struct Async_Buffer *Async_BufferRef(struct Async_Buffer *buffer)
+{
+    if (buffer != NULL)
+    {
+        atomic_inc(&(buffer->references));
+    }
+
+    return buffer;
+}
+
+void Async_BufferUnref(struct Async_Buffer *buffer)
+{
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    // If that was the last reference, give the buffer back
+    if (atomic_dec(&(buffer->references)) == 1)
+    {
+        k_heap_free(&asyncPool, buffer);
+    }
+}
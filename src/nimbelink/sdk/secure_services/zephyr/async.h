@@ -0,0 +1,67 @@
+/**
+ * \file
+ *
+ * \brief Dispatches asynchronous secure service messages and manages their
+ *        buffers
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nimbelink/sdk/secure_services/async.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Copies an asynchronous message into a new buffer
+ *
+ *  The buffer starts out with a single reference, which belongs to the caller.
+ *  If there's no data to copy, the buffer's contents are left for the caller
+ *  to fill in.
+ *
+ * \param event
+ *      The event that occurred
+ * \param *data
+ *      The message's data
+ * \param length
+ *      The length of the message's data
+ *
+ * \return NULL
+ *      Not enough room left in the pool
+ * \return struct Async_Buffer *
+ *      The buffer
+ */
+struct Async_Buffer *AllocateAsyncBuffer(uint32_t event, const void *data, size_t length);
+
+/**
+ * \brief Hands an asynchronous message to its event's handler
+ *
+ *  Messages for events without a handler are dropped.
+ *
+ * \param event
+ *      The event that occurred
+ * \param *data
+ *      The message's data
+ * \param size
+ *      The size of the message's data, which might just be the size of the
+ *      buffer it was delivered in
+ *
+ * \return none
+ */
+void DispatchAsyncEvent(uint32_t event, const void *data, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -17,6 +17,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <device.h>
 #include <init.h>
@@ -26,6 +27,19 @@
 #include "nimbelink/sdk/secure_services/at.h"
 #include "nimbelink/sdk/secure_services/call.h"
 #include "nimbelink/sdk/secure_services/kernel.h"
+#include "nimbelink/sdk/secure_services/net.h"
+#include "nimbelink/sdk/secure_services/zephyr/async.h"
+#include "nimbelink/sdk/secure_services/zephyr/histogram.h"
+#include "nimbelink/sdk/secure_services/zephyr/transport.h"
+#include "nimbelink/sdk/secure_services/zephyr/urc.h"
+
+#if !CONFIG_SECURE_SERVICES_EMULATOR
+#include <hal/nrf_egu.h>
+#endif
+
+#if CONFIG_SECURE_SERVICES_LATENCY_SHELL || CONFIG_SECURE_SERVICES_TRACE_SHELL
+#include <shell/shell.h>
+#endif
 
 // Semaphores for signalling incoming secure service responses, one for each
 // potential EGU trigger and one for our asynchronous channel
@@ -34,6 +48,174 @@ static struct k_sem semaphores[SECURE_SERVICE_CHANNEL_COUNT + 1];
 // A bitfield for managing channels
 static uint16_t channels = 0;
 
+// A semaphore counting the free channels, which callers wait on when all of
+// the channels are in use
+static K_SEM_DEFINE(channelSemaphore, SECURE_SERVICE_CHANNEL_COUNT, SECURE_SERVICE_CHANNEL_COUNT);
+
+/**
+ * \brief An outstanding asynchronous request on a bidirectional channel
+ */
+struct AsyncRequest
+{
+    // Work for retrieving the response outside of the interrupt
+    struct k_work work;
+
+    // The request
+    uint32_t request;
+
+    // The request's parameters, which must remain valid until completion
+    void *parameters;
+
+    // The size of the parameters
+    uint32_t size;
+
+    // The callback to invoke when the request completes
+    SecureServiceCallback callback;
+
+    // A context to pass to the callback
+    void *context;
+};
+
+// Asynchronous request handling, one for each bidirectional channel
+static struct AsyncRequest asyncRequests[SECURE_SERVICE_CHANNEL_COUNT];
+
+// The work queue asynchronous requests are completed on
+static struct k_work_q completionQueue;
+
+static K_THREAD_STACK_DEFINE(completionStack, CONFIG_SECURE_SERVICES_COMPLETION_STACK_SIZE);
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+// When each channel's response was last signalled, in cycles
+static volatile uint32_t signalCycles[SECURE_SERVICE_CHANNEL_COUNT + 1];
+
+// Latency statistics for each service's APIs
+static struct SecureServiceLatencyStats latencyStats[SECURE_SERVICE_COUNT][CONFIG_SECURE_SERVICES_LATENCY_API_COUNT];
+
+// A lock for our latency statistics
+static struct k_spinlock latencyLock;
+
+/**
+ * \brief Notes the cycle count at a point in a call
+ */
+#define LATENCY_STAMP(stamps, point)    ((stamps)[(point)] = k_cycle_get_32())
+#else
+#define LATENCY_STAMP(stamps, point)
+#endif
+
+/**
+ * \brief The points in a call we note the cycle count at
+ *
+ *  Each phase of a call runs from the point with its index to the next one.
+ */
+enum LatencyPoint
+{
+    LatencyPoint_Start      = SecureServiceLatency_Reserve,
+    LatencyPoint_Reserved   = SecureServiceLatency_Put,
+    LatencyPoint_Put        = SecureServiceLatency_Secure,
+    LatencyPoint_Signalled  = SecureServiceLatency_Wake,
+    LatencyPoint_Woken      = SecureServiceLatency_Get,
+    LatencyPoint_Done       = SecureServiceLatency_Count,
+
+    LatencyPoint_Count
+};
+
+#if CONFIG_SECURE_SERVICES_TRACE
+// The most recent calls and asynchronous events
+static struct SecureServiceTraceEntry traceEntries[CONFIG_SECURE_SERVICES_TRACE_DEPTH];
+
+// How many entries have ever been traced
+static atomic_t traceCount = ATOMIC_INIT(0);
+
+// The request outstanding on each bidirectional channel
+static struct SecureServiceInFlight inFlight[SECURE_SERVICE_CHANNEL_COUNT];
+
+// Make sure we can find our place in the trace with a mask
+BUILD_ASSERT((CONFIG_SECURE_SERVICES_TRACE_DEPTH & (CONFIG_SECURE_SERVICES_TRACE_DEPTH - 1)) == 0);
+#endif
+
+/**
+ * \brief Notes a request is outstanding on its channel
+ *
+ * \param request
+ *      The request
+ *
+ * \return none
+ */
+static inline void TraceBegin(uint32_t request)
+{
+#if CONFIG_SECURE_SERVICES_TRACE
+    struct SecureServiceInFlight *entry = &(inFlight[GET_CHANNEL(request)]);
+
+    entry->start = k_cycle_get_32();
+    entry->request = request;
+    entry->active = true;
+#else
+    (void)request;
+#endif
+}
+
+/**
+ * \brief Adds an entry to the trace
+ *
+ * \param kind
+ *      What's being traced
+ * \param request
+ *      The request
+ * \param result
+ *      The result
+ * \param start
+ *      The cycle count when the traced operation started
+ *
+ * \return none
+ */
+static inline void TraceAdd(enum SecureServiceTrace kind, uint32_t request, int32_t result, uint32_t start)
+{
+#if CONFIG_SECURE_SERVICES_TRACE
+    uint32_t now = k_cycle_get_32();
+
+    // Claiming a slot is the only thing that needs to be atomic -- anyone
+    // looking at the trace while the slot is being filled in will just see a
+    // partially-updated entry
+    uint32_t index = (uint32_t)atomic_inc(&traceCount) & (CONFIG_SECURE_SERVICES_TRACE_DEPTH - 1);
+
+    struct SecureServiceTraceEntry *entry = &(traceEntries[index]);
+
+    entry->kind = kind;
+    entry->request = request;
+    entry->result = result;
+    entry->timestamp = now;
+    entry->duration = now - start;
+#else
+    (void)kind;
+    (void)request;
+    (void)result;
+    (void)start;
+#endif
+}
+
+/**
+ * \brief Adds an entry for a request outstanding on its channel to the trace
+ *
+ * \param kind
+ *      What's being traced
+ * \param request
+ *      The request
+ * \param result
+ *      The result
+ *
+ * \return none
+ */
+static inline void TraceEnd(enum SecureServiceTrace kind, uint32_t request, int32_t result)
+{
+#if CONFIG_SECURE_SERVICES_TRACE
+    TraceAdd(kind, request, result, inFlight[GET_CHANNEL(request)].start);
+#else
+    (void)kind;
+    (void)request;
+    (void)result;
+#endif
+}
+
 // Make sure the bitfield is big enough for all of our bidirectional channels
 BUILD_ASSERT((sizeof(channels) * CHAR_BIT) >= SECURE_SERVICE_CHANNEL_COUNT);
 
@@ -41,6 +223,7 @@ BUILD_ASSERT((sizeof(channels) * CHAR_BIT) >= SECURE_SERVICE_CHANNEL_COUNT);
 // bidirectional ones
 BUILD_ASSERT(SECURE_SERVICE_ASYNC_CHANNEL == SECURE_SERVICE_CHANNEL_COUNT);
 
+#if !CONFIG_SECURE_SERVICES_EMULATOR
 /**
  * \brief Requests pending the Non-Secure PendSV interrupt
  *
@@ -66,6 +249,7 @@ void arch_set_pendsv(void)
     // (in the ARM core's eyes).
     irq_unlock(key);
 }
+#endif
 
 /**
  * \brief Wraps calling the Non-Secure Callable API with scheduler locking
@@ -119,7 +303,7 @@ static inline int32_t PutSecureServiceRequest(uint32_t request, void *parameters
 {
     bool locked;
 
-    if (!k_is_in_isr())
+    if (IS_ENABLED(CONFIG_SECURE_SERVICES_SCHED_LOCK) && !k_is_in_isr())
     {
         locked = true;
         k_sched_lock();
@@ -156,7 +340,7 @@ static inline int32_t GetSecureServiceResponse(uint32_t request, void *parameter
 {
     bool locked;
 
-    if (!k_is_in_isr())
+    if (IS_ENABLED(CONFIG_SECURE_SERVICES_SCHED_LOCK) && !k_is_in_isr())
     {
         locked = true;
         k_sched_lock();
@@ -176,6 +360,33 @@ static inline int32_t GetSecureServiceResponse(uint32_t request, void *parameter
     return result;
 }
 
+/**
+ * \brief Signals a secure service channel's response is available
+ *
+ * \param channel
+ *      The channel to signal
+ *
+ * \return none
+ */
+void SignalSecureServiceChannel(size_t channel)
+{
+#if CONFIG_SECURE_SERVICES_LATENCY
+    signalCycles[channel] = k_cycle_get_32();
+#endif
+
+    // If an asynchronous request is waiting on this channel, retrieve its
+    // response outside of the interrupt
+    if ((channel < SECURE_SERVICE_CHANNEL_COUNT) && (asyncRequests[channel].callback != NULL))
+    {
+        k_work_submit_to_queue(&completionQueue, &(asyncRequests[channel].work));
+        return;
+    }
+
+    // Note there's an available response using our signalling semaphore
+    k_sem_give(&(semaphores[channel]));
+}
+
+#if !CONFIG_SECURE_SERVICES_EMULATOR
 /**
  * \brief Gets an EGU 'task' from an index
  *
@@ -237,8 +448,7 @@ static inline void HandleEguInterrupt(size_t channel)
     // Clear the event for the next time
     nrf_egu_event_clear(NRF_EGU2, GetEguEvent(channel));
 
-    // Note there's an available response using our signalling semaphore
-    k_sem_give(&(semaphores[channel]));
+    SignalSecureServiceChannel(channel);
 }
 
 /**
@@ -262,55 +472,228 @@ static void __attribute__((used)) EguInterrupt(void *arg)
     // Also handle our asynchronous channel
     HandleEguInterrupt(SECURE_SERVICE_ASYNC_CHANNEL);
 }
+#endif
 
-// A callback for incoming AT URCs
-static At_UrcCallback urcCallback = NULL;
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+// A callback for incoming socket readiness notifications
+static Net_ReadinessCallback readinessCallback = NULL;
+#endif
 
 /**
- * \brief Monitors asynchronous secure service messages
+ * \brief Handles a URC message
  *
- * \param none
+ * \param event
+ *      Unused
+ * \param *data
+ *      The URC
+ * \param size
+ *      The size of the message's data
+ * \param *context
+ *      Unused
  *
  * \return none
  */
-static void MonitorAsync(void)
+static void HandleUrcEvent(uint32_t event, const void *data, size_t size, void *context)
 {
-    static struct Async_Parameters parameters;
+    (void)event;
+    (void)context;
 
-    while (true)
+    // Leave running the subscribers to the URC work queue, so we can keep
+    // draining messages
+    QueueSecureServiceUrc((const char *)data, size);
+}
+
+#if CONFIG_SECURE_SERVICES_EXPERIMENTAL_ABI
+/**
+ * \brief Handles a socket readiness message
+ *
+ * \param event
+ *      Unused
+ * \param *data
+ *      The readiness event
+ * \param size
+ *      The size of the message's data
+ * \param *context
+ *      Unused
+ *
+ * \return none
+ */
+static void HandleReadinessEvent(uint32_t event, const void *data, size_t size, void *context)
+{
+    (void)event;
+    (void)context;
+
+    // The callback is set before this is registered, so it's always valid
+    if (size >= sizeof(struct Net_ReadinessEvent))
+    {
+        const struct Net_ReadinessEvent *readiness = (const struct Net_ReadinessEvent *)data;
+
+        readinessCallback(readiness->fd, readiness->revents);
+    }
+}
+
+int32_t Net_SubscribeReadiness(Net_ReadinessCallback callback)
+{
+    if (callback == NULL)
+    {
+        return -EINVAL;
+    }
+
+    // Set the callback and register its handler together, so a notification
+    // never sees one without the other
+    uint32_t key = irq_lock();
+
+    int32_t result = Async_RegisterHandler(Async_Event_NetReadiness, HandleReadinessEvent, NULL);
+
+    if (result == 0)
+    {
+        readinessCallback = callback;
+    }
+
+    irq_unlock(key);
+
+    return result;
+}
+#endif
+
+#if CONFIG_SECURE_SERVICES_ASYNC_BATCH
+BUILD_ASSERT(CONFIG_SECURE_SERVICES_ASYNC_BATCH_SIZE >= (sizeof(struct Async_BatchParameters) + ASYNC_BATCH_MESSAGE_SIZE(sizeof(((struct Async_Parameters *)NULL)->buffer))));
+
+// Storage for a batch of asynchronous messages
+static uint32_t asyncBatch[CONFIG_SECURE_SERVICES_ASYNC_BATCH_SIZE / sizeof(uint32_t)];
+#else
+// Storage for a single asynchronous message
+static struct Async_Parameters asyncParameters;
+#endif
+
+#if CONFIG_SECURE_SERVICES_ASYNC_THREAD_CUSTOM_PRIORITY
+#define SECURE_SERVICE_ASYNC_THREAD_PRIORITY    CONFIG_SECURE_SERVICES_ASYNC_THREAD_PRIORITY
+#else
+#define SECURE_SERVICE_ASYNC_THREAD_PRIORITY    K_HIGHEST_APPLICATION_THREAD_PRIO
+#endif
+
+/**
+ * \brief Handles an asynchronous message
+ *
+ * \param event
+ *      The event that occurred
+ * \param *data
+ *      The message's data
+ * \param size
+ *      The size of the message's data
+ *
+ * \return none
+ */
+static void HandleAsyncMessage(uint32_t event, const void *data, size_t size)
+{
+#if CONFIG_SECURE_SERVICES_TRACE
+    uint32_t start = k_cycle_get_32();
+#endif
+
+    // Hand the message to whoever handles its event
+    DispatchAsyncEvent(event, data, size);
+
+#if CONFIG_SECURE_SERVICES_TRACE
+    TraceAdd(SecureServiceTrace_Event, CREATE_REQUEST(SECURE_SERVICE_ASYNC_CHANNEL, 0, event), 0, start);
+#endif
+}
+
+/**
+ * \brief Drains asynchronous messages
+ *
+ * \param budget
+ *      The most messages to drain, or 0 for all of them
+ *
+ * \return size_t
+ *      The number of messages drained
+ */
+static size_t DrainAsyncMessages(size_t budget)
+{
+    size_t drained = 0;
+
+    while ((budget == 0) || (drained < budget))
     {
-        // Avoid getting more messages than our semaphore can handle and loop
-        // until we run out of messages
-        while (true)
+    #if CONFIG_SECURE_SERVICES_ASYNC_BATCH
+        struct Async_BatchParameters *batch = (struct Async_BatchParameters *)asyncBatch;
+
+        // Ask for whatever's left of our budget
+        batch->count = (budget == 0) ? UINT32_MAX : (uint32_t)(budget - drained);
+
+        int32_t result = GetSecureServiceResponse(CREATE_REQUEST(SECURE_SERVICE_ASYNC_CHANNEL, 0, Async_Api_GetMessages), asyncBatch, sizeof(asyncBatch));
+
+        // If that failed or came back empty, we must be out of messages
+        if ((result != 0) || (batch->count == 0))
+        {
+            break;
+        }
+
+        const uint8_t *next = batch->messages;
+        const uint8_t *end = (const uint8_t *)asyncBatch + sizeof(asyncBatch);
+
+        for (uint32_t i = 0; i < batch->count; i++)
         {
-            // Try to get the async message
-            int32_t result = GetSecureServiceResponse(CREATE_REQUEST(SECURE_SERVICE_ASYNC_CHANNEL, 0, 0), &parameters, sizeof(parameters));
+            const struct Async_BatchMessage *message = (const struct Async_BatchMessage *)next;
 
-            // If that failed, we must be out of messages, so wait for more
-            // notifications
-            if (result != 0)
+            // Don't follow a message off the end of the batch
+            if ((size_t)(end - next) < sizeof(*message))
             {
                 break;
             }
 
-            // Figure out what to do
-            switch ((enum Async_Event)parameters.event)
+            if (message->length > ((size_t)(end - next) - sizeof(*message)))
             {
-                case Async_Event_AtUrc:
-                {
-                    // Atomically grab the callback
-                    At_UrcCallback callback = urcCallback;
+                break;
+            }
 
-                    // If there is a valid callback, invoke it
-                    if (callback != NULL)
-                    {
-                        callback((const char *)parameters.buffer);
-                    }
+            HandleAsyncMessage(message->event, message->data, message->length);
 
-                    break;
-                }
-            }
+            drained++;
+
+            next += ASYNC_BATCH_MESSAGE_SIZE(message->length);
+        }
+    #else
+        int32_t result = GetSecureServiceResponse(CREATE_REQUEST(SECURE_SERVICE_ASYNC_CHANNEL, 0, Async_Api_GetMessage), &asyncParameters, sizeof(asyncParameters));
+
+        // If that failed, we must be out of messages
+        if (result != 0)
+        {
+            break;
+        }
+
+        HandleAsyncMessage(asyncParameters.event, asyncParameters.buffer, sizeof(asyncParameters.buffer));
+
+        drained++;
+    #endif
+    }
+
+    return drained;
+}
+
+/**
+ * \brief Monitors asynchronous secure service messages
+ *
+ * \param none
+ *
+ * \return none
+ */
+static void MonitorAsync(void)
+{
+    while (true)
+    {
+    #if CONFIG_SECURE_SERVICES_ASYNC_DRAIN_BUDGET > 0
+        size_t drained = DrainAsyncMessages(CONFIG_SECURE_SERVICES_ASYNC_DRAIN_BUDGET);
+
+        // If we used up our budget, there are probably more messages waiting,
+        // but give everyone else a chance to run before we get them
+        if (drained >= CONFIG_SECURE_SERVICES_ASYNC_DRAIN_BUDGET)
+        {
+            k_usleep(CONFIG_SECURE_SERVICES_ASYNC_DRAIN_BACKOFF_US);
+
+            continue;
         }
+    #else
+        DrainAsyncMessages(0);
+    #endif
 
         // Wait for something to come in
         //
@@ -334,7 +717,7 @@ K_THREAD_DEFINE(
     NULL,
     NULL,
     NULL,
-    K_HIGHEST_APPLICATION_THREAD_PRIO,
+    SECURE_SERVICE_ASYNC_THREAD_PRIORITY,
     0,
     0
 );
@@ -342,16 +725,36 @@ K_THREAD_DEFINE(
 /**
  * \brief Reserves a secure service channel
  *
+ *  If all of the channels are in use, this will wait for one to be freed.
+ *  Waiting callers are served by the kernel in priority order, and in FIFO
+ *  order within the same priority. Interrupts and the completion work queue
+ *  never wait.
+ *
  * \param *channel
  *      Where to store the reserved channel
+ * \param timeout
+ *      How long to wait for a channel to be freed
  *
  * \return false
  *      No channels available
  * \return true
  *      Channel reserved
  */
-static bool ReserveChannel(uint8_t *channel)
+static bool ReserveChannel(uint8_t *channel, k_timeout_t timeout)
 {
+    // We can't wait when in an interrupt, nor on the completion work queue,
+    // which is what frees the channels of asynchronous requests
+    if (k_is_in_isr() || (k_current_get() == &(completionQueue.thread)))
+    {
+        timeout = K_NO_WAIT;
+    }
+
+    // Wait for a channel to be free
+    if (k_sem_take(&channelSemaphore, timeout) != 0)
+    {
+        return false;
+    }
+
     uint32_t key = irq_lock();
 
     // Guilty until proven innocent
@@ -386,6 +789,13 @@ static bool ReserveChannel(uint8_t *channel)
  */
 static void FreeChannel(uint8_t channel)
 {
+#if CONFIG_SECURE_SERVICES_TRACE
+    if (channel < SECURE_SERVICE_CHANNEL_COUNT)
+    {
+        inFlight[channel].active = false;
+    }
+#endif
+
     uint32_t key = irq_lock();
 
     // If it's valid, clear this channel
@@ -395,6 +805,30 @@ static void FreeChannel(uint8_t channel)
     }
 
     irq_unlock(key);
+
+    // Let the next waiter have it
+    if (channel < SECURE_SERVICE_CHANNEL_COUNT)
+    {
+        k_sem_give(&channelSemaphore);
+    }
+}
+
+/**
+ * \brief Gets how long blocking calls will wait for a free channel
+ *
+ * \param none
+ *
+ * \return k_timeout_t
+ *      How long to wait
+ */
+static inline k_timeout_t ChannelTimeout(void)
+{
+    if (CONFIG_SECURE_SERVICES_CHANNEL_TIMEOUT < 0)
+    {
+        return K_FOREVER;
+    }
+
+    return K_MSEC(CONFIG_SECURE_SERVICES_CHANNEL_TIMEOUT);
 }
 
 /**
@@ -421,22 +855,16 @@ static bool HandleInternalService(int32_t *result, uint8_t service, uint16_t api
     // If this is subscribing to AT URCs, we'll handle that internally
     if ((service == SecureService_At) && (api == At_Api_SubscribeUrcs))
     {
-        uint32_t key = irq_lock();
-
         // Assume this won't go well
         *result = -ENOMEM;
 
-        // If the callback isn't set yet and the parameters look fine, allow
-        // this
-        if ((urcCallback == NULL) && (parameters != NULL) && (size == sizeof(struct At_SubscribeUrcsParameters)))
+        // If the parameters look fine, try to set the callback, which only
+        // works once
+        if ((parameters != NULL) && (size == sizeof(struct At_SubscribeUrcsParameters)))
         {
-            urcCallback = ((struct At_SubscribeUrcsParameters *)parameters)->callback;
-
-            *result = 0;
+            *result = SubscribeSecureServiceUrcs(((struct At_SubscribeUrcsParameters *)parameters)->callback);
         }
 
-        irq_unlock(key);
-
         return true;
     }
 
@@ -445,74 +873,705 @@ static bool HandleInternalService(int32_t *result, uint8_t service, uint16_t api
 }
 
 /**
- * \brief Handles calling a secure service
+ * \brief Gets how much of a timeout remains
  *
- * \param service
- *      The secure service
- * \param api
- *      The service's API
- * \param *parameters
- *      Parameters for the call
- * \param size
- *      The size of the parameters
+ * \param timeout
+ *      The original timeout
+ * \param start
+ *      When the timeout started, in ticks
  *
- * \return int32_t
- *      The result of the call
+ * \return k_timeout_t
+ *      The remaining timeout
  */
-int32_t CallSecureService(uint8_t service, uint16_t api, void *parameters, uint32_t size)
+static inline k_timeout_t RemainingTimeout(k_timeout_t timeout, int64_t start)
 {
-    int32_t result;
-
-    if (HandleInternalService(&result, service, api, parameters, size))
+    // Forever is forever, and nothing is nothing
+    if (K_TIMEOUT_EQ(timeout, K_FOREVER) || K_TIMEOUT_EQ(timeout, K_NO_WAIT))
     {
-        return result;
+        return timeout;
     }
 
-    // Grab a semaphore for dispatching our request
-    uint8_t channel;
-
-    // If that failed, we won't be able to manage our request
-    if (!ReserveChannel(&channel))
+#if CONFIG_TIMEOUT_64BIT
+    // An absolute timeout is already a deadline, which the kernel can wait on
+    // as-is
+    if (Z_TICK_ABS(timeout.ticks) >= 0)
     {
-        return -ETIMEDOUT;
+        return timeout;
     }
+#endif
 
-    // Make sure we don't have a synchronization issue and we wait for a proper
-    // signal
-    k_sem_take(&(semaphores[channel]), K_NO_WAIT);
-
-    // Try to queue our request
-    result = PutSecureServiceRequest(CREATE_REQUEST(channel, service, api), parameters, size);
+    int64_t remaining = (int64_t)timeout.ticks - (k_uptime_ticks() - start);
 
-    // If our result was handled immediately, that's a success
-    if (result == 1)
+    if (remaining <= 0)
     {
-        result = 0;
-        goto Done;
+        return K_NO_WAIT;
     }
 
-    // If that failed, that's going to be our result
-    if (result != 0)
-    {
-        goto Done;
-    }
+    return K_TICKS(remaining);
+}
 
-    // Wait for a response
-    result = k_sem_take(&(semaphores[channel]), K_FOREVER);
+// Buffers for consuming the late responses of timed out requests, one for
+// each bidirectional channel
+//
+// Timed calls with larger parameters are refused, so a late response is
+// always retrieved with the size its request was queued with.
+static uint32_t drainBuffers[SECURE_SERVICE_CHANNEL_COUNT][(CONFIG_SECURE_SERVICES_DRAIN_BUFFER_SIZE + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
 
-    // If we failed to get a response, we're done
-    if (result != 0)
-    {
-        result = -ETIMEDOUT;
-        goto Done;
-    }
+/**
+ * \brief Handles a timed out request's late response having been consumed
+ *
+ * \param result
+ *      The late response's result
+ * \param *context
+ *      Unused
+ *
+ * \return none
+ */
+static void DrainedResponse(int32_t result, void *context)
+{
+    (void)result;
+    (void)context;
+}
+
+/**
+ * \brief Puts a channel whose request timed out into a 'draining' state
+ *
+ *  The Secure firmware still owes us a response for the request, so the
+ *  channel can't be handed out again yet. Instead, the channel is handed over
+ *  to our asynchronous handling, which will consume the late response into a
+ *  scratch buffer -- rather than the caller's parameters, which might be long
+ *  gone by then -- and only then free the channel.
+ *
+ * \param channel
+ *      The channel to drain
+ * \param request
+ *      The request that timed out
+ * \param size
+ *      The size of the request's parameters
+ *
+ * \return false
+ *      The response arrived in the meantime, so the channel wasn't drained
+ * \return true
+ *      The channel is draining
+ */
+static bool DrainChannel(uint8_t channel, uint32_t request, uint32_t size)
+{
+    uint32_t key = irq_lock();
+
+    // If the response showed up after all, let the caller have it
+    if (k_sem_take(&(semaphores[channel]), K_NO_WAIT) == 0)
+    {
+        irq_unlock(key);
+
+        return false;
+    }
+
+    struct AsyncRequest *asyncRequest = &(asyncRequests[channel]);
+
+    asyncRequest->request = request;
+    asyncRequest->parameters = drainBuffers[channel];
+    asyncRequest->size = size;
+    asyncRequest->context = NULL;
+    asyncRequest->callback = DrainedResponse;
+
+    irq_unlock(key);
+
+    return true;
+}
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+/**
+ * \brief Clears latency statistics
+ *
+ * \param *stats
+ *      The statistics to clear
+ *
+ * \return none
+ */
+static void ClearLatency(struct SecureServiceLatencyStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    stats->minTotal = UINT32_MAX;
+}
+
+/**
+ * \brief Records a completed call's latency
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ * \param *stamps
+ *      The cycle counts at each point in the call
+ *
+ * \return none
+ */
+static void RecordLatency(uint8_t service, uint16_t api, uint32_t *stamps)
+{
+    if ((service >= SECURE_SERVICE_COUNT) || (api >= CONFIG_SECURE_SERVICES_LATENCY_API_COUNT))
+    {
+        return;
+    }
+
+    // The response can be signalled before the request has finished being
+    // queued, which is really no time at all waiting on the Secure handler
+    if ((int32_t)(stamps[LatencyPoint_Signalled] - stamps[LatencyPoint_Put]) < 0)
+    {
+        stamps[LatencyPoint_Signalled] = stamps[LatencyPoint_Put];
+    }
+
+    uint32_t durations[SecureServiceLatency_Count];
+
+    for (size_t i = 0; i < SecureServiceLatency_Count; i++)
+    {
+        durations[i] = k_cyc_to_us_floor32(stamps[i + 1] - stamps[i]);
+    }
+
+    uint32_t total = k_cyc_to_us_floor32(stamps[LatencyPoint_Done] - stamps[LatencyPoint_Start]);
+
+    k_spinlock_key_t key = k_spin_lock(&latencyLock);
+
+    struct SecureServiceLatencyStats *stats = &(latencyStats[service][api]);
+
+    stats->count++;
+
+    for (size_t i = 0; i < SecureServiceLatency_Count; i++)
+    {
+        stats->phaseTotals[i] += durations[i];
+        stats->phaseMaxes[i] = MAX(stats->phaseMaxes[i], durations[i]);
+    }
+
+    stats->minTotal = MIN(stats->minTotal, total);
+    stats->maxTotal = MAX(stats->maxTotal, total);
+
+    AddLatencyHistogram(stats->histogram, SECURE_SERVICE_LATENCY_BUCKET_COUNT, SECURE_SERVICE_LATENCY_FIRST_BUCKET_US, total);
+
+    k_spin_unlock(&latencyLock, key);
+}
+
+/**
+ * \brief Records a call that timed out
+ *
+ *  Timed out calls never made a full round trip, so they're counted on their
+ *  own rather than measured.
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ *
+ * \return none
+ */
+static void RecordLatencyTimeout(uint8_t service, uint16_t api)
+{
+    if ((service >= SECURE_SERVICE_COUNT) || (api >= CONFIG_SECURE_SERVICES_LATENCY_API_COUNT))
+    {
+        return;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&latencyLock);
+
+    latencyStats[service][api].timeouts++;
+
+    k_spin_unlock(&latencyLock, key);
+}
+
+/**
+ * \brief Gets a secure service API's latency statistics
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ * \param *stats
+ *      Where to store the statistics
+ *
+ * \return -EINVAL
+ *      Invalid service, API, or statistics pointer
+ * \return 0
+ *      Statistics retrieved
+ */
+int32_t GetSecureServiceLatency(uint8_t service, uint16_t api, struct SecureServiceLatencyStats *stats)
+{
+    if ((service >= SECURE_SERVICE_COUNT) || (api >= CONFIG_SECURE_SERVICES_LATENCY_API_COUNT) || (stats == NULL))
+    {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&latencyLock);
+
+    *stats = latencyStats[service][api];
+
+    k_spin_unlock(&latencyLock, key);
+
+    return 0;
+}
+
+/**
+ * \brief Resets all secure service latency statistics
+ *
+ * \param none
+ *
+ * \return none
+ */
+void ResetSecureServiceLatency(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&latencyLock);
+
+    for (size_t i = 0; i < SECURE_SERVICE_COUNT; i++)
+    {
+        for (size_t j = 0; j < CONFIG_SECURE_SERVICES_LATENCY_API_COUNT; j++)
+        {
+            ClearLatency(&(latencyStats[i][j]));
+        }
+    }
+
+    k_spin_unlock(&latencyLock, key);
+}
+#endif
+
+/**
+ * \brief Handles calling a secure service
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ * \param *parameters
+ *      Parameters for the call
+ * \param size
+ *      The size of the parameters
+ * \param channelTimeout
+ *      How long to wait for a free channel
+ * \param timeout
+ *      How long to wait for the whole call, including the free channel
+ *
+ * \return int32_t
+ *      The result of the call
+ */
+static int32_t Call(uint8_t service, uint16_t api, void *parameters, uint32_t size, k_timeout_t channelTimeout, k_timeout_t timeout)
+{
+    int32_t result;
+
+    int64_t start = k_uptime_ticks();
+
+    if (HandleInternalService(&result, service, api, parameters, size))
+    {
+        return result;
+    }
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+    uint32_t stamps[LatencyPoint_Count];
+    enum LatencyPoint last = LatencyPoint_Start;
+#endif
+
+    LATENCY_STAMP(stamps, LatencyPoint_Start);
+
+    // Grab a semaphore for dispatching our request
+    uint8_t channel;
+
+    // If that failed, we won't be able to manage our request
+    if (!ReserveChannel(&channel, channelTimeout))
+    {
+    #if CONFIG_SECURE_SERVICES_LATENCY
+        RecordLatencyTimeout(service, api);
+    #endif
+
+        return -ETIMEDOUT;
+    }
+
+    LATENCY_STAMP(stamps, LatencyPoint_Reserved);
+
+    uint32_t request = CREATE_REQUEST(channel, service, api);
+
+    TraceBegin(request);
+
+    // Make sure we don't have a synchronization issue and we wait for a proper
+    // signal
+    k_sem_take(&(semaphores[channel]), K_NO_WAIT);
+
+    // Try to queue our request
+    result = PutSecureServiceRequest(request, parameters, size);
+
+    LATENCY_STAMP(stamps, LatencyPoint_Put);
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+    last = LatencyPoint_Put;
+#endif
+
+    // If our result was handled immediately, that's a success
+    if (result == 1)
+    {
+        result = 0;
+        goto Done;
+    }
+
+    // If that failed, that's going to be our result
+    if (result != 0)
+    {
+        goto Done;
+    }
+
+    // Wait for a response
+    result = k_sem_take(&(semaphores[channel]), RemainingTimeout(timeout, start));
+
+    // If we failed to get a response in time, the channel will be freed once
+    // the late response is consumed
+    if ((result != 0) && DrainChannel(channel, request, size))
+    {
+        TraceEnd(SecureServiceTrace_Timeout, request, -ETIMEDOUT);
+
+    #if CONFIG_SECURE_SERVICES_LATENCY
+        RecordLatencyTimeout(service, api);
+    #endif
+
+        return -ETIMEDOUT;
+    }
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+    stamps[LatencyPoint_Signalled] = signalCycles[channel];
+#endif
+
+    LATENCY_STAMP(stamps, LatencyPoint_Woken);
 
     // Get the response and use its result as our result
-    result = GetSecureServiceResponse(CREATE_REQUEST(channel, service, api), parameters, size);
+    result = GetSecureServiceResponse(request, parameters, size);
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+    last = LatencyPoint_Woken;
+#endif
 
 Done:
+    TraceEnd(SecureServiceTrace_Call, request, result);
+
+    FreeChannel(channel);
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+    LATENCY_STAMP(stamps, LatencyPoint_Done);
+
+    // If we didn't wait for a response, everything after queueing the request
+    // took no time
+    if (last == LatencyPoint_Put)
+    {
+        stamps[LatencyPoint_Signalled] = stamps[LatencyPoint_Put];
+        stamps[LatencyPoint_Woken] = stamps[LatencyPoint_Put];
+    }
+
+    RecordLatency(service, api, stamps);
+#endif
+
+    return result;
+}
+
+/**
+ * \brief Handles calling a secure service
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ * \param *parameters
+ *      Parameters for the call
+ * \param size
+ *      The size of the parameters
+ *
+ * \return int32_t
+ *      The result of the call
+ */
+int32_t CallSecureService(uint8_t service, uint16_t api, void *parameters, uint32_t size)
+{
+    return Call(service, api, parameters, size, ChannelTimeout(), K_FOREVER);
+}
+
+/**
+ * \brief Handles calling a secure service with a deadline
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ * \param *parameters
+ *      Parameters for the call
+ * \param size
+ *      The size of the parameters
+ * \param timeout
+ *      How long to wait for the call, including waiting for a free channel
+ *
+ * \return -EINVAL
+ *      Parameters too large to drain if the call times out
+ * \return -ETIMEDOUT
+ *      The call didn't complete in time
+ * \return int32_t
+ *      The result of the call
+ */
+int32_t CallSecureServiceTimeout(uint8_t service, uint16_t api, void *parameters, uint32_t size, k_timeout_t timeout)
+{
+    // If the call could time out, we need to be able to consume its late
+    // response exactly as it was requested
+    if (!K_TIMEOUT_EQ(timeout, K_FOREVER) && (size > sizeof(drainBuffers[0])))
+    {
+        return -EINVAL;
+    }
+
+    return Call(service, api, parameters, size, timeout, timeout);
+}
+
+/**
+ * \brief Handles calling a batch of secure services
+ *
+ *  The Secure firmware takes a single request per submission, so the batch
+ *  is spread across as many channels as are free: requests are queued on
+ *  every available channel before waiting on any of them, and each response
+ *  frees its channel for the next request in the batch. The batch thus costs
+ *  about as long as its slowest requests rather than the sum of them all.
+ *
+ * \param *entries
+ *      The requests to make, whose results will be filled in
+ * \param count
+ *      The number of requests
+ *
+ * \return -EINVAL
+ *      Invalid entries
+ * \return 0
+ *      Batch handled, check each entry's result
+ */
+int32_t CallSecureServiceBatch(struct SecureServiceBatchEntry *entries, size_t count)
+{
+    if ((entries == NULL) && (count > 0))
+    {
+        return -EINVAL;
+    }
+
+    // The entries currently waiting on a response, oldest first
+    size_t pending[SECURE_SERVICE_CHANNEL_COUNT];
+    uint8_t pendingChannels[SECURE_SERVICE_CHANNEL_COUNT];
+    size_t pendingCount = 0;
+
+    size_t next = 0;
+
+    while (true)
+    {
+        // Queue as many of the remaining requests as we can
+        while (next < count)
+        {
+            struct SecureServiceBatchEntry *entry = &(entries[next]);
+
+            if (HandleInternalService(&(entry->result), entry->service, entry->api, entry->parameters, entry->size))
+            {
+                next++;
+                continue;
+            }
+
+            // Only wait for a channel if we don't already have responses
+            // coming that will free one up
+            k_timeout_t timeout = (pendingCount == 0) ? ChannelTimeout() : K_NO_WAIT;
+
+            uint8_t channel;
+
+            if (!ReserveChannel(&channel, timeout))
+            {
+                // If nothing is pending, no channel is going to free up on
+                // our account, so give up on this one
+                if (pendingCount == 0)
+                {
+                    entry->result = -ETIMEDOUT;
+                    next++;
+                    continue;
+                }
+
+                break;
+            }
+
+            k_sem_take(&(semaphores[channel]), K_NO_WAIT);
+
+            uint32_t request = CREATE_REQUEST(channel, entry->service, entry->api);
+
+            TraceBegin(request);
+
+            entry->result = PutSecureServiceRequest(request, entry->parameters, entry->size);
+
+            next++;
+
+            // If a response is coming, note we need to wait for it
+            if (entry->result == 0)
+            {
+                pending[pendingCount] = next - 1;
+                pendingChannels[pendingCount] = channel;
+                pendingCount++;
+
+                continue;
+            }
+
+            // If our result was handled immediately, that's a success
+            if (entry->result == 1)
+            {
+                entry->result = 0;
+            }
+
+            TraceEnd(SecureServiceTrace_Call, request, entry->result);
+
+            FreeChannel(channel);
+        }
+
+        // If nothing is pending, we must be done
+        if (pendingCount == 0)
+        {
+            break;
+        }
+
+        // Wait for our oldest request's response
+        struct SecureServiceBatchEntry *entry = &(entries[pending[0]]);
+        uint8_t channel = pendingChannels[0];
+
+        uint32_t request = CREATE_REQUEST(channel, entry->service, entry->api);
+
+        if (k_sem_take(&(semaphores[channel]), K_FOREVER) != 0)
+        {
+            entry->result = -ETIMEDOUT;
+        }
+        else
+        {
+            entry->result = GetSecureServiceResponse(request, entry->parameters, entry->size);
+        }
+
+        TraceEnd(SecureServiceTrace_Call, request, entry->result);
+
+        FreeChannel(channel);
+
+        pendingCount--;
+
+        for (size_t i = 0; i < pendingCount; i++)
+        {
+            pending[i] = pending[i + 1];
+            pendingChannels[i] = pendingChannels[i + 1];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Completes an asynchronous secure service request
+ *
+ * \param *work
+ *      The asynchronous request's work
+ *
+ * \return none
+ */
+static void CompleteAsync(struct k_work *work)
+{
+    struct AsyncRequest *asyncRequest = CONTAINER_OF(work, struct AsyncRequest, work);
+
+    uint8_t channel = (uint8_t)(asyncRequest - asyncRequests);
+
+    // Get the response and use its result as our result
+    int32_t result = GetSecureServiceResponse(asyncRequest->request, asyncRequest->parameters, asyncRequest->size);
+
+    SecureServiceCallback callback = asyncRequest->callback;
+    void *context = asyncRequest->context;
+
+    TraceEnd(SecureServiceTrace_Async, asyncRequest->request, result);
+
+    // Release the channel before invoking the callback, in case the callback
+    // wants to queue up another request
+    asyncRequest->callback = NULL;
+
+    FreeChannel(channel);
+
+    callback(result, context);
+}
+
+/**
+ * \brief Queues a secure service call without waiting for its response
+ *
+ * \param service
+ *      The secure service
+ * \param api
+ *      The service's API
+ * \param *parameters
+ *      Parameters for the call, which must remain valid until the callback is
+ *      invoked
+ * \param size
+ *      The size of the parameters
+ * \param callback
+ *      The callback to invoke with the call's result
+ * \param *context
+ *      A context to pass to the callback
+ *
+ * \return -EINVAL
+ *      No callback provided
+ * \return -ETIMEDOUT
+ *      No channels available
+ * \return <0
+ *      Failed to queue the request
+ * \return 0
+ *      Request queued, and the callback will be invoked
+ */
+int32_t CallSecureServiceAsync(uint8_t service, uint16_t api, void *parameters, uint32_t size, SecureServiceCallback callback, void *context)
+{
+    int32_t result;
+
+    if (callback == NULL)
+    {
+        return -EINVAL;
+    }
+
+    // If this is handled internally, it's already done
+    if (HandleInternalService(&result, service, api, parameters, size))
+    {
+        callback(result, context);
+
+        return 0;
+    }
+
+    uint8_t channel;
+
+    // Asynchronous calls don't wait for a channel, so if that failed, we won't
+    // be able to manage our request
+    if (!ReserveChannel(&channel, K_NO_WAIT))
+    {
+        return -ETIMEDOUT;
+    }
+
+    struct AsyncRequest *asyncRequest = &(asyncRequests[channel]);
+
+    asyncRequest->request = CREATE_REQUEST(channel, service, api);
+    asyncRequest->parameters = parameters;
+    asyncRequest->size = size;
+    asyncRequest->context = context;
+
+    TraceBegin(asyncRequest->request);
+
+    // Set the callback last, as that's what marks the channel as asynchronous
+    // for our interrupt
+    asyncRequest->callback = callback;
+
+    // Try to queue our request
+    result = PutSecureServiceRequest(asyncRequest->request, parameters, size);
+
+    // If that succeeded and a response is coming, the callback will take it
+    // from here
+    if (result == 0)
+    {
+        return 0;
+    }
+
+    // Otherwise no response is coming, so release the channel ourselves
+    asyncRequest->callback = NULL;
+
+    TraceEnd(SecureServiceTrace_Async, asyncRequest->request, result);
+
     FreeChannel(channel);
 
+    // If our result was handled immediately, that's a success
+    if (result == 1)
+    {
+        callback(0, context);
+
+        return 0;
+    }
+
     return result;
 }
 
@@ -529,8 +1588,10 @@ static inline void SetupEguChannel(size_t channel)
     // Initialize our signalling semaphore
     k_sem_init(&(semaphores[channel]), 0, 1);
 
+#if !CONFIG_SECURE_SERVICES_EMULATOR
     nrf_egu_subscribe_set(NRF_EGU2, GetEguTask(channel), channel);
     nrf_egu_publish_set(NRF_EGU2, GetEguEvent(channel), channel);
+#endif
 }
 
 /**
@@ -550,21 +1611,359 @@ static int SetupSecureServices(const struct device *device)
     for (size_t i = 0; i < SECURE_SERVICE_CHANNEL_COUNT; i++)
     {
         SetupEguChannel(i);
+
+        k_work_init(&(asyncRequests[i].work), CompleteAsync);
     }
 
     // Also set up a channel for the asynchronous messages
     SetupEguChannel(SECURE_SERVICE_ASYNC_CHANNEL);
 
+    // Claim the asynchronous events we handle ourselves
+    Async_RegisterHandler(Async_Event_AtUrc, HandleUrcEvent, NULL);
+
+#if CONFIG_SECURE_SERVICES_LATENCY
+    ResetSecureServiceLatency();
+#endif
+
+#if !CONFIG_SECURE_SERVICES_EMULATOR
     nrf_egu_int_enable(NRF_EGU2, NRF_EGU_INT_ALL);
 
     // We expect to already have access to EGU2 before we're launched, so don't
     // bother requesting it
     IRQ_CONNECT(EGU2_IRQn, 6, EguInterrupt, NULL, 0);
     irq_enable(EGU2_IRQn);
+#endif
+
+    return 0;
+}
+
+#if CONFIG_SECURE_SERVICES_TRACE
+/**
+ * \brief Visits the traced calls and events, oldest first
+ *
+ * \param visitor
+ *      The visitor to invoke for each entry
+ * \param *context
+ *      A context to pass to the visitor
+ *
+ * \return size_t
+ *      The number of entries visited
+ */
+size_t VisitSecureServiceTrace(SecureServiceTraceVisitor visitor, void *context)
+{
+    if (visitor == NULL)
+    {
+        return 0;
+    }
+
+    uint32_t count = (uint32_t)atomic_get(&traceCount);
+    uint32_t first = (count > CONFIG_SECURE_SERVICES_TRACE_DEPTH) ? (count - CONFIG_SECURE_SERVICES_TRACE_DEPTH) : 0;
+
+    for (uint32_t i = first; i != count; i++)
+    {
+        // Take a copy, so the visitor sees a consistent entry even if it's
+        // being overwritten
+        struct SecureServiceTraceEntry entry = traceEntries[i & (CONFIG_SECURE_SERVICES_TRACE_DEPTH - 1)];
+
+        visitor(&entry, context);
+    }
+
+    return count - first;
+}
+
+/**
+ * \brief Gets the request outstanding on a channel
+ *
+ * \param channel
+ *      The channel
+ * \param *info
+ *      Where to store the request's information
+ *
+ * \return -EINVAL
+ *      Invalid channel or information pointer
+ * \return 0
+ *      Information retrieved
+ */
+int32_t GetSecureServiceInFlight(uint8_t channel, struct SecureServiceInFlight *info)
+{
+    if ((channel >= SECURE_SERVICE_CHANNEL_COUNT) || (info == NULL))
+    {
+        return -EINVAL;
+    }
+
+    *info = inFlight[channel];
 
     return 0;
 }
 
+/**
+ * \brief Gets the name of a traced entry's kind
+ *
+ * \param kind
+ *      The kind
+ *
+ * \return const char *
+ *      The name
+ */
+static const char *TraceKindName(uint8_t kind)
+{
+    switch ((enum SecureServiceTrace)kind)
+    {
+        case SecureServiceTrace_Call:       return "call";
+        case SecureServiceTrace_Async:      return "async";
+        case SecureServiceTrace_Timeout:    return "timeout";
+        case SecureServiceTrace_Event:      return "event";
+    }
+
+    return "?";
+}
+
+/**
+ * \brief Prints a traced entry with printk()
+ *
+ * \param *entry
+ *      The entry
+ * \param *context
+ *      Unused
+ *
+ * \return none
+ */
+static void PrintTraceEntry(const struct SecureServiceTraceEntry *entry, void *context)
+{
+    (void)context;
+
+    printk(
+        "ss trace: %s ch=%u svc=%u api=%u result=%d at=%u dur_us=%u\n",
+        TraceKindName(entry->kind),
+        GET_CHANNEL(entry->request),
+        GET_SERVICE(entry->request),
+        GET_API(entry->request),
+        entry->result,
+        entry->timestamp,
+        k_cyc_to_us_floor32(entry->duration)
+    );
+}
+
+/**
+ * \brief Prints the outstanding requests and the trace with printk()
+ *
+ *  This is safe to call from a fatal error handler.
+ *
+ * \param none
+ *
+ * \return none
+ */
+void DumpSecureServiceTrace(void)
+{
+    uint32_t now = k_cycle_get_32();
+
+    for (uint8_t i = 0; i < SECURE_SERVICE_CHANNEL_COUNT; i++)
+    {
+        struct SecureServiceInFlight info = inFlight[i];
+
+        if (!info.active)
+        {
+            continue;
+        }
+
+        printk(
+            "ss in flight: ch=%u svc=%u api=%u for_us=%u\n",
+            i,
+            GET_SERVICE(info.request),
+            GET_API(info.request),
+            k_cyc_to_us_floor32(now - info.start)
+        );
+    }
+
+    VisitSecureServiceTrace(PrintTraceEntry, NULL);
+}
+#endif
+
+#if CONFIG_SECURE_SERVICES_TRACE_SHELL
+/**
+ * \brief Prints a traced entry to a shell
+ *
+ * \param *entry
+ *      The entry
+ * \param *context
+ *      The shell
+ *
+ * \return none
+ */
+static void ShellTraceEntry(const struct SecureServiceTraceEntry *entry, void *context)
+{
+    shell_print(
+        (const struct shell *)context,
+        "kind=%s ch=%u svc=%u api=%u result=%d at=%u dur_us=%u",
+        TraceKindName(entry->kind),
+        GET_CHANNEL(entry->request),
+        GET_SERVICE(entry->request),
+        GET_API(entry->request),
+        entry->result,
+        entry->timestamp,
+        k_cyc_to_us_floor32(entry->duration)
+    );
+}
+
+static int ShellTrace(const struct shell *shell, size_t argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    uint32_t now = k_cycle_get_32();
+
+    for (uint8_t i = 0; i < SECURE_SERVICE_CHANNEL_COUNT; i++)
+    {
+        struct SecureServiceInFlight info;
+
+        GetSecureServiceInFlight(i, &info);
+
+        if (!info.active)
+        {
+            continue;
+        }
+
+        shell_print(
+            shell,
+            "kind=in_flight ch=%u svc=%u api=%u for_us=%u",
+            i,
+            GET_SERVICE(info.request),
+            GET_API(info.request),
+            k_cyc_to_us_floor32(now - info.start)
+        );
+    }
+
+    VisitSecureServiceTrace(ShellTraceEntry, (void *)shell);
+
+    return 0;
+}
+#endif
+
+#if CONFIG_SECURE_SERVICES_LATENCY_SHELL
+// The secure services' names
+static const char * const serviceNames[SECURE_SERVICE_COUNT] = {
+    [SecureService_Kernel]  = "kernel",
+    [SecureService_At]      = "at",
+    [SecureService_App]     = "app",
+    [SecureService_Net]     = "net",
+};
+
+static int ShellLatency(const struct shell *shell, size_t argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    for (uint8_t service = 0; service < SECURE_SERVICE_COUNT; service++)
+    {
+        for (uint16_t api = 0; api < CONFIG_SECURE_SERVICES_LATENCY_API_COUNT; api++)
+        {
+            struct SecureServiceLatencyStats stats;
+
+            GetSecureServiceLatency(service, api, &stats);
+
+            if ((stats.count == 0) && (stats.timeouts == 0))
+            {
+                continue;
+            }
+
+            // Don't divide by zero if everything timed out
+            uint32_t count = MAX(stats.count, 1);
+
+            char histogram[LATENCY_HISTOGRAM_STRING_SIZE(SECURE_SERVICE_LATENCY_BUCKET_COUNT)];
+
+            // Print averages for each phase, and the extremes and histogram
+            // of the whole round trip, all in microseconds
+            shell_print(
+                shell,
+                "service=%s api=%u count=%u timeouts=%u "
+                "reserve_avg=%u put_avg=%u secure_avg=%u wake_avg=%u get_avg=%u "
+                "reserve_max=%u put_max=%u secure_max=%u wake_max=%u get_max=%u "
+                "min=%u max=%u hist=%s",
+                serviceNames[service],
+                api,
+                stats.count,
+                stats.timeouts,
+                (uint32_t)(stats.phaseTotals[SecureServiceLatency_Reserve] / count),
+                (uint32_t)(stats.phaseTotals[SecureServiceLatency_Put] / count),
+                (uint32_t)(stats.phaseTotals[SecureServiceLatency_Secure] / count),
+                (uint32_t)(stats.phaseTotals[SecureServiceLatency_Wake] / count),
+                (uint32_t)(stats.phaseTotals[SecureServiceLatency_Get] / count),
+                stats.phaseMaxes[SecureServiceLatency_Reserve],
+                stats.phaseMaxes[SecureServiceLatency_Put],
+                stats.phaseMaxes[SecureServiceLatency_Secure],
+                stats.phaseMaxes[SecureServiceLatency_Wake],
+                stats.phaseMaxes[SecureServiceLatency_Get],
+                (stats.count > 0) ? stats.minTotal : 0,
+                stats.maxTotal,
+                FormatLatencyHistogram(histogram, sizeof(histogram), stats.histogram, SECURE_SERVICE_LATENCY_BUCKET_COUNT)
+            );
+        }
+    }
+
+    return 0;
+}
+
+static int ShellLatencyReset(const struct shell *shell, size_t argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    ResetSecureServiceLatency();
+
+    shell_print(shell, "Latency statistics reset");
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(secureServicesLatencyShell,
+    SHELL_CMD(reset, NULL, "Reset latency statistics", ShellLatencyReset),
+    SHELL_SUBCMD_SET_END
+);
+#endif
+
+#if CONFIG_SECURE_SERVICES_LATENCY_SHELL || CONFIG_SECURE_SERVICES_TRACE_SHELL
+SHELL_STATIC_SUBCMD_SET_CREATE(secureServicesShell,
+#if CONFIG_SECURE_SERVICES_LATENCY_SHELL
+    SHELL_CMD(latency, &secureServicesLatencyShell, "Show secure service call latencies", ShellLatency),
+#endif
+#if CONFIG_SECURE_SERVICES_TRACE_SHELL
+    SHELL_CMD(trace, NULL, "Show outstanding and recent secure service calls", ShellTrace),
+#endif
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(secure_services, &secureServicesShell, "Secure services", NULL);
+#endif
+
+/**
+ * \brief Starts the asynchronous request completion work queue
+ *
+ * \param *device
+ *      Unused
+ *
+ * \return 0
+ *      Always
+ */
+static int StartCompletionQueue(const struct device *device)
+{
+    (void)device;
+
+    k_work_q_start(
+        &completionQueue,
+        completionStack,
+        K_THREAD_STACK_SIZEOF(completionStack),
+        CONFIG_SECURE_SERVICES_COMPLETION_PRIORITY
+    );
+
+    k_thread_name_set(&(completionQueue.thread), "secure_service_completion");
+
+    return 0;
+}
+
+// Asynchronous requests can't be made before the kernel is up, so their work
+// queue can wait until then
+SYS_INIT(StartCompletionQueue, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+
 // Run our secure service setup during system initialization, as early as
 // possible (to beat any driver initializations that depend on access to the
 // peripherals). We also need to beat our own peripheral access requesting (if
@@ -0,0 +1,103 @@
+/**
+ * \file
+ *
+ * \brief Latency histograms shared by the SDK's statistics
+ *
+ *  Each histogram bucket's upper limit is four times the one before it, and
+ *  the last bucket holds everything else.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief How long a formatted histogram can be, including the terminator
+ *
+ *  This fits 10 digits and a comma for each bucket.
+ *
+ * \param count
+ *      The number of buckets
+ */
+#define LATENCY_HISTOGRAM_STRING_SIZE(count)    ((count) * 11)
+
+/**
+ * \brief Records a value in a latency histogram
+ *
+ * \param *histogram
+ *      The histogram's buckets
+ * \param count
+ *      The number of buckets
+ * \param firstLimit
+ *      The upper limit of the first bucket
+ * \param value
+ *      The value to record
+ *
+ * \return none
+ */
+static inline void AddLatencyHistogram(uint32_t *histogram, size_t count, uint32_t firstLimit, uint32_t value)
+{
+    size_t bucket = 0;
+
+    for (uint64_t limit = firstLimit; (value >= limit) && (bucket < (count - 1)); limit *= 4)
+    {
+        bucket++;
+    }
+
+    histogram[bucket]++;
+}
+
+/**
+ * \brief Formats a latency histogram as a comma-separated list of counts
+ *
+ * \param *buffer
+ *      Where to store the string, which should be at least
+ *      LATENCY_HISTOGRAM_STRING_SIZE(count) long
+ * \param size
+ *      The size of the buffer
+ * \param *histogram
+ *      The histogram's buckets
+ * \param count
+ *      The number of buckets
+ *
+ * \return const char *
+ *      The string
+ */
+static inline const char *FormatLatencyHistogram(char *buffer, size_t size, const uint32_t *histogram, size_t count)
+{
+    size_t length = 0;
+
+    buffer[0] = '\0';
+
+    for (size_t i = 0; (i < count) && (length < size); i++)
+    {
+        int result = snprintf(&(buffer[length]), size - length, (i == 0) ? "%u" : ",%u", (unsigned int)histogram[i]);
+
+        if (result < 0)
+        {
+            break;
+        }
+
+        length += result;
+    }
+
+    return buffer;
+}
+
+#ifdef __cplusplus
+}
+#endif
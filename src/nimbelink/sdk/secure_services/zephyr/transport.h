@@ -0,0 +1,42 @@
+/**
+ * \file
+ *
+ * \brief The hooks between the secure service handling and its transport
+ *
+ *  On hardware the transport is the Secure firmware's veneers and the EGU2
+ *  interrupt. When CONFIG_SECURE_SERVICES_EMULATOR is enabled, the emulator
+ *  provides the veneers instead and signals responses through these hooks.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Signals a secure service channel's response is available
+ *
+ *  This is safe to call from an interrupt.
+ *
+ * \param channel
+ *      The channel to signal, which is either one of the bidirectional
+ *      channels or SECURE_SERVICE_ASYNC_CHANNEL
+ *
+ * \return none
+ */
+void SignalSecureServiceChannel(size_t channel);
+
+#ifdef __cplusplus
+}
+#endif
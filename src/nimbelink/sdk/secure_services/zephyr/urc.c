@@ -0,0 +1,629 @@
+/**
+ * \file
+ *
+ * \brief Distributes URCs from the Secure firmware to their subscribers
+ *
+ *  Subscriptions hang off the nodes of a prefix trie, with one node for each
+ *  character of each prefix. Dispatching a URC walks the trie along the URC's
+ *  characters and notifies the subscriptions on each node it passes, so a URC
+ *  only costs a step per matching character, no matter how many subscribers
+ *  there are.
+ *
+ *  URCs are normally queued by the asynchronous message thread and dispatched
+ *  from a work queue of their own, so a slow subscriber can't hold up draining
+ *  the Secure firmware's asynchronous messages. Each URC is copied once into
+ *  an asynchronous message buffer just big enough for it, and the queue is a
+ *  lock-free ring of references to those buffers with a single producer and a
+ *  single consumer. Subscribers are lent the buffer itself, and can keep it by
+ *  taking a reference of their own.
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <init.h>
+#include <zephyr.h>
+
+#if CONFIG_SECURE_SERVICES_URC_QUEUE
+#include <sys/ring_buffer.h>
+#endif
+
+#include "nimbelink/sdk/secure_services/async.h"
+#include "nimbelink/sdk/secure_services/at.h"
+#include "nimbelink/sdk/secure_services/zephyr/async.h"
+#include "nimbelink/sdk/secure_services/zephyr/urc.h"
+
+/**
+ * \brief An invalid trie node index
+ */
+#define URC_NODE_NONE   UINT16_MAX
+
+BUILD_ASSERT(CONFIG_SECURE_SERVICES_URC_TRIE_NODES < URC_NODE_NONE);
+
+/**
+ * \brief A node in the prefix trie
+ */
+struct UrcNode
+{
+    // Whether or not this node is in use
+    bool used;
+
+    // The prefix character this node matches
+    char character;
+
+    // The node's parent, first child, and next sibling
+    uint16_t parent;
+    uint16_t child;
+    uint16_t sibling;
+
+    // The subscriptions whose prefix ends at this node
+    struct At_UrcSubscription *subscriptions;
+};
+
+// The prefix trie, whose root holds subscriptions to every URC
+static struct UrcNode nodes[CONFIG_SECURE_SERVICES_URC_TRIE_NODES] = {
+    [0] = {
+        .used = true,
+        .parent = URC_NODE_NONE,
+        .child = URC_NODE_NONE,
+        .sibling = URC_NODE_NONE
+    }
+};
+
+// A lock for the trie and its subscriptions
+static K_MUTEX_DEFINE(urcLock);
+
+// A lock for dispatching URCs one at a time
+//
+// This is taken before the trie's lock, and is held while handlers run, so
+// handlers are free to use the trie's lock.
+static K_MUTEX_DEFINE(dispatchLock);
+
+// The current dispatch, which marks the subscriptions it has handled
+static uint32_t dispatchGeneration = 0;
+
+// Whether or not a URC is being dispatched
+static bool dispatching = false;
+
+// Whether or not nodes were left unpruned during a dispatch
+static bool prunePending = false;
+
+// The subscription whose handler is running, and the thread running it
+static struct At_UrcSubscription *runningSubscription = NULL;
+static k_tid_t dispatchThread = NULL;
+
+// How many threads are waiting for the running handler to finish
+static uint32_t handlerWaiters = 0;
+
+// A semaphore for waking threads waiting for the running handler to finish
+static K_SEM_DEFINE(handlerDone, 0, K_SEM_MAX_LIMIT);
+
+// The single At_SubscribeUrcs() callback and its subscription
+static At_UrcCallback urcCallback = NULL;
+static struct At_UrcSubscription urcCallbackSubscription;
+
+/**
+ * \brief The longest URC we can get from the Secure firmware, including its
+ *        NULL terminator
+ */
+#define URC_MAX_SIZE    sizeof(((struct Async_Parameters *)NULL)->buffer)
+
+// How many URCs were dropped because there wasn't room for them
+static atomic_t urcDrops = ATOMIC_INIT(0);
+
+#if CONFIG_SECURE_SERVICES_URC_QUEUE
+// References to the URCs waiting to be dispatched
+RING_BUF_DECLARE(urcQueue, CONFIG_SECURE_SERVICES_URC_QUEUE_DEPTH * sizeof(struct Async_Buffer *));
+
+// The most URCs the queue has held at once
+static atomic_t urcQueueHighWater = ATOMIC_INIT(0);
+
+static struct k_work_q urcWorkQueue;
+
+static K_THREAD_STACK_DEFINE(urcWorkQueueStack, CONFIG_SECURE_SERVICES_URC_WORKQ_STACK_SIZE);
+
+static void DispatchQueuedUrcs(struct k_work *work);
+
+static K_WORK_DEFINE(urcWork, DispatchQueuedUrcs);
+#endif
+
+/**
+ * \brief Finds a node's child for a character
+ *
+ * \param index
+ *      The node
+ * \param character
+ *      The character
+ *
+ * \return URC_NODE_NONE
+ *      No child for the character
+ * \return uint16_t
+ *      The child
+ */
+static uint16_t FindChild(uint16_t index, char character)
+{
+    for (uint16_t child = nodes[index].child; child != URC_NODE_NONE; child = nodes[child].sibling)
+    {
+        if (nodes[child].character == character)
+        {
+            return child;
+        }
+    }
+
+    return URC_NODE_NONE;
+}
+
+/**
+ * \brief Adds a child to a node
+ *
+ * \param index
+ *      The node
+ * \param character
+ *      The child's character
+ *
+ * \return URC_NODE_NONE
+ *      No free nodes
+ * \return uint16_t
+ *      The child
+ */
+static uint16_t AddChild(uint16_t index, char character)
+{
+    for (uint16_t child = 1; child < ARRAY_SIZE(nodes); child++)
+    {
+        if (nodes[child].used)
+        {
+            continue;
+        }
+
+        nodes[child] = (struct UrcNode){
+            .used = true,
+            .character = character,
+            .parent = index,
+            .child = URC_NODE_NONE,
+            .sibling = nodes[index].child,
+            .subscriptions = NULL
+        };
+
+        nodes[index].child = child;
+
+        return child;
+    }
+
+    return URC_NODE_NONE;
+}
+
+/**
+ * \brief Frees a node and any of its ancestors that are no longer needed
+ *
+ * \param index
+ *      The node
+ *
+ * \return none
+ */
+static void Prune(uint16_t index)
+{
+    // Never free the root, and stop at anything that's still in use
+    while ((index != 0) && (nodes[index].subscriptions == NULL) && (nodes[index].child == URC_NODE_NONE))
+    {
+        uint16_t parent = nodes[index].parent;
+
+        // Unlink the node from its siblings
+        uint16_t *link = &(nodes[parent].child);
+
+        while (*link != index)
+        {
+            link = &(nodes[*link].sibling);
+        }
+
+        *link = nodes[index].sibling;
+
+        nodes[index].used = false;
+
+        index = parent;
+    }
+}
+
+int32_t At_AddUrcSubscription(struct At_UrcSubscription *subscription)
+{
+    if ((subscription == NULL) || (subscription->prefix == NULL) || (subscription->handler == NULL))
+    {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&urcLock, K_FOREVER);
+
+    if (subscription->active)
+    {
+        k_mutex_unlock(&urcLock);
+
+        return -EALREADY;
+    }
+
+    // Find the prefix's node, adding any that are missing along the way
+    uint16_t index = 0;
+
+    for (const char *character = subscription->prefix; *character != '\0'; character++)
+    {
+        uint16_t child = FindChild(index, *character);
+
+        if (child == URC_NODE_NONE)
+        {
+            child = AddChild(index, *character);
+        }
+
+        // If we ran out of nodes, give back any we just added
+        if (child == URC_NODE_NONE)
+        {
+            Prune(index);
+
+            k_mutex_unlock(&urcLock);
+
+            return -ENOMEM;
+        }
+
+        index = child;
+    }
+
+    // Add the subscription after any others with the same prefix
+    struct At_UrcSubscription **link = &(nodes[index].subscriptions);
+
+    while (*link != NULL)
+    {
+        link = &((*link)->next);
+    }
+
+    subscription->next = NULL;
+    subscription->node = index;
+    subscription->active = true;
+
+    // If this is being added during a dispatch, don't hand it that URC
+    subscription->generation = dispatchGeneration;
+
+    *link = subscription;
+
+    k_mutex_unlock(&urcLock);
+
+    return 0;
+}
+
+int32_t At_RemoveUrcSubscription(struct At_UrcSubscription *subscription)
+{
+    if (subscription == NULL)
+    {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&urcLock, K_FOREVER);
+
+    // If another thread is running the subscription's handler, wait for it to
+    // finish, so the subscription isn't used once it's removed
+    while ((runningSubscription == subscription) && (k_current_get() != dispatchThread))
+    {
+        handlerWaiters++;
+
+        k_mutex_unlock(&urcLock);
+
+        k_sem_take(&handlerDone, K_FOREVER);
+
+        k_mutex_lock(&urcLock, K_FOREVER);
+    }
+
+    if (!subscription->active)
+    {
+        k_mutex_unlock(&urcLock);
+
+        return -ENOENT;
+    }
+
+    struct At_UrcSubscription **link = &(nodes[subscription->node].subscriptions);
+
+    while (*link != subscription)
+    {
+        link = &((*link)->next);
+    }
+
+    *link = subscription->next;
+
+    subscription->next = NULL;
+    subscription->active = false;
+
+    // Don't free nodes out from under a dispatch, and instead prune once it's
+    // done
+    if (dispatching)
+    {
+        prunePending = true;
+    }
+    else
+    {
+        Prune(subscription->node);
+    }
+
+    k_mutex_unlock(&urcLock);
+
+    return 0;
+}
+
+/**
+ * \brief Passes a URC to the single At_SubscribeUrcs() callback
+ *
+ * \param *urc
+ *      The URC
+ * \param *context
+ *      Unused
+ *
+ * \return none
+ */
+static void HandleUrcCallback(const char *urc, void *context)
+{
+    (void)context;
+
+    At_UrcCallback callback = urcCallback;
+
+    if (callback != NULL)
+    {
+        callback(urc);
+    }
+}
+
+int32_t SubscribeSecureServiceUrcs(At_UrcCallback callback)
+{
+    if (callback == NULL)
+    {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&urcLock, K_FOREVER);
+
+    // Only one callback has ever been allowed
+    if (urcCallback != NULL)
+    {
+        k_mutex_unlock(&urcLock);
+
+        return -ENOMEM;
+    }
+
+    urcCallback = callback;
+
+    urcCallbackSubscription = (struct At_UrcSubscription){
+        .prefix = "",
+        .handler = HandleUrcCallback
+    };
+
+    int32_t result = At_AddUrcSubscription(&urcCallbackSubscription);
+
+    k_mutex_unlock(&urcLock);
+
+    return result;
+}
+
+void DispatchSecureServiceUrc(const char *urc)
+{
+    k_mutex_lock(&dispatchLock, K_FOREVER);
+    k_mutex_lock(&urcLock, K_FOREVER);
+
+    dispatchGeneration++;
+    dispatching = true;
+    dispatchThread = k_current_get();
+
+    uint16_t index = 0;
+
+    const char *character = urc;
+
+    // Notify everyone whose prefix matches, starting with the subscribers to
+    // every URC
+    while (true)
+    {
+        struct At_UrcSubscription *subscription = nodes[index].subscriptions;
+
+        while (subscription != NULL)
+        {
+            if (subscription->generation == dispatchGeneration)
+            {
+                subscription = subscription->next;
+                continue;
+            }
+
+            subscription->generation = dispatchGeneration;
+
+            // Don't hold the lock while the handler runs, so other threads
+            // can keep using subscriptions, and removing this one waits for
+            // the handler to finish
+            At_UrcHandler handler = subscription->handler;
+            void *context = subscription->context;
+
+            runningSubscription = subscription;
+
+            k_mutex_unlock(&urcLock);
+
+            handler(urc, context);
+
+            k_mutex_lock(&urcLock, K_FOREVER);
+
+            runningSubscription = NULL;
+
+            for (; handlerWaiters > 0; handlerWaiters--)
+            {
+                k_sem_give(&handlerDone);
+            }
+
+            // Anything could have removed any of the subscriptions meanwhile,
+            // but pruning waits for us, so start over at this node, skipping
+            // the ones that were already handled
+            subscription = nodes[index].subscriptions;
+        }
+
+        if (*character == '\0')
+        {
+            break;
+        }
+
+        index = FindChild(index, *character);
+
+        if (index == URC_NODE_NONE)
+        {
+            break;
+        }
+
+        character++;
+    }
+
+    dispatching = false;
+    dispatchThread = NULL;
+
+    // If handlers removed subscriptions, free any nodes that aren't needed
+    // anymore
+    if (prunePending)
+    {
+        prunePending = false;
+
+        for (uint16_t i = 1; i < ARRAY_SIZE(nodes); i++)
+        {
+            if (nodes[i].used)
+            {
+                Prune(i);
+            }
+        }
+    }
+
+    k_mutex_unlock(&urcLock);
+    k_mutex_unlock(&dispatchLock);
+}
+
+#if CONFIG_SECURE_SERVICES_URC_QUEUE
+/**
+ * \brief Dispatches queued URCs
+ *
+ * \param *work
+ *      Unused
+ *
+ * \return none
+ */
+static void DispatchQueuedUrcs(struct k_work *work)
+{
+    (void)work;
+
+    struct Async_Buffer *buffer;
+
+    while (ring_buf_get(&urcQueue, (uint8_t *)&buffer, sizeof(buffer)) == sizeof(buffer))
+    {
+        DispatchSecureServiceUrc((const char *)buffer->data);
+
+        // Let go of the queue's reference, leaving any the subscribers took
+        Async_BufferUnref(buffer);
+    }
+}
+#endif
+
+void QueueSecureServiceUrc(const char *urc, size_t maxLength)
+{
+    size_t length = strnlen(urc, MIN(maxLength, URC_MAX_SIZE - 1));
+
+    // Copy just the URC, and supply its NULL terminator ourselves, in case the
+    // URC filled the whole message
+    struct Async_Buffer *buffer = AllocateAsyncBuffer(Async_Event_AtUrc, NULL, length + 1);
+
+    if (buffer == NULL)
+    {
+        atomic_inc(&urcDrops);
+
+        return;
+    }
+
+    memcpy(buffer->data, urc, length);
+
+    buffer->data[length] = '\0';
+
+#if CONFIG_SECURE_SERVICES_URC_QUEUE
+    uint32_t space = ring_buf_space_get(&urcQueue);
+
+    // If there isn't room for this, drop it rather than hold up the Secure
+    // firmware's other asynchronous messages
+    //
+    // A reference is published in a single put, so the consumer never sees a
+    // partial one.
+    if ((space < sizeof(buffer)) || (ring_buf_put(&urcQueue, (uint8_t *)&buffer, sizeof(buffer)) != sizeof(buffer)))
+    {
+        Async_BufferUnref(buffer);
+
+        atomic_inc(&urcDrops);
+
+        return;
+    }
+
+    // We're the only producer, so nobody else can be raising the high-water
+    // mark
+    uint32_t used = (ring_buf_capacity_get(&urcQueue) - space) / sizeof(buffer) + 1;
+
+    if (used > (uint32_t)atomic_get(&urcQueueHighWater))
+    {
+        atomic_set(&urcQueueHighWater, (atomic_val_t)used);
+    }
+
+    k_work_submit_to_queue(&urcWorkQueue, &urcWork);
+#else
+    DispatchSecureServiceUrc((const char *)buffer->data);
+
+    Async_BufferUnref(buffer);
+#endif
+}
+
+void At_GetUrcQueueStats(struct At_UrcQueueStats *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+
+#if CONFIG_SECURE_SERVICES_URC_QUEUE
+    uint32_t capacity = ring_buf_capacity_get(&urcQueue);
+
+    *stats = (struct At_UrcQueueStats){
+        .drops = (uint32_t)atomic_get(&urcDrops),
+        .used = (capacity - ring_buf_space_get(&urcQueue)) / sizeof(struct Async_Buffer *),
+        .highWater = (uint32_t)atomic_get(&urcQueueHighWater),
+        .capacity = capacity / sizeof(struct Async_Buffer *)
+    };
+#else
+    *stats = (struct At_UrcQueueStats){
+        .drops = (uint32_t)atomic_get(&urcDrops)
+    };
+#endif
+}
+
+#if CONFIG_SECURE_SERVICES_URC_QUEUE
+/**
+ * \brief Starts the URC work queue
+ *
+ * \param *device
+ *      Unused
+ *
+ * \return 0
+ *      Always
+ */
+static int StartUrcWorkQueue(const struct device *device)
+{
+    (void)device;
+
+    k_work_q_start(
+        &urcWorkQueue,
+        urcWorkQueueStack,
+        K_THREAD_STACK_SIZEOF(urcWorkQueueStack),
+        CONFIG_SECURE_SERVICES_URC_WORKQ_PRIORITY
+    );
+
+    k_thread_name_set(&(urcWorkQueue.thread), "secure_service_urc");
+
+    return 0;
+}
+
+SYS_INIT(StartUrcWorkQueue, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+#endif
@@ -0,0 +1,68 @@
+/**
+ * \file
+ *
+ * \brief Distributes URCs from the Secure firmware to their subscribers
+ *
+ * (C) NimbeLink Corp. 2020
+ *
+ * All rights reserved except as explicitly granted in the license agreement
+ * between NimbeLink Corp. and the designated licensee.  No other use or
+ * disclosure of this software is permitted. Portions of this software may be
+ * subject to third party license terms as specified in this software, and such
+ * portions are excluded from the preceding copyright notice of NimbeLink Corp.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nimbelink/sdk/secure_services/at.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * \brief Sets the single At_SubscribeUrcs() callback
+ *
+ * \param callback
+ *      The callback to invoke with every URC
+ *
+ * \return -EINVAL
+ *      Invalid callback
+ * \return -ENOMEM
+ *      A callback is already subscribed
+ * \return 0
+ *      Callback subscribed
+ */
+int32_t SubscribeSecureServiceUrcs(At_UrcCallback callback);
+
+/**
+ * \brief Queues a URC for its subscribers
+ *
+ *  If the URC queue is disabled, this dispatches the URC right away. Only the
+ *  asynchronous message thread may queue URCs.
+ *
+ * \param *urc
+ *      The URC
+ * \param maxLength
+ *      The most characters the URC can have, if it isn't NULL-terminated
+ *
+ * \return none
+ */
+void QueueSecureServiceUrc(const char *urc, size_t maxLength);
+
+/**
+ * \brief Hands a URC to its subscribers
+ *
+ * \param *urc
+ *      The URC
+ *
+ * \return none
+ */
+void DispatchSecureServiceUrc(const char *urc);
+
+#ifdef __cplusplus
+}
+#endif